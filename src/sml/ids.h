@@ -9,7 +9,14 @@ struct OnExitEventId {};
 struct TerminalStateId {};
 struct BypassStateId {};
 struct KeepStateId {};
+struct DeferStateId {};
 
-using EphemeralStateIds = tl::List<BypassStateId, KeepStateId>;
+// Base of states and submachines with local data. Their ids are then default constructed
+// on entry, passed by reference to guards and actions as the state argument and
+// destroyed on exit, in storage within the SM shared with the data of states that are
+// never active at the same time.
+struct Local {};
+
+using EphemeralStateIds = tl::List<BypassStateId, KeepStateId, DeferStateId>;
 
 }  // namespace sml
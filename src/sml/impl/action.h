@@ -0,0 +1,51 @@
+#pragma once
+
+#include "sml/impl/invoke.h"
+
+#include <type_traits>
+#include <utility>
+
+namespace sml::impl::action {
+
+// Arbitrary action lifted into the action algebra
+template <typename F>
+struct Act {
+    [[no_unique_address]] F f;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr void operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        invoke(f, sid, e, ctx...);
+    }
+};
+
+template <typename A, typename B>
+struct Seq {
+    [[no_unique_address]] A a;
+    [[no_unique_address]] B b;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr void operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        a(sid, e, ctx...);
+        b(sid, e, ctx...);
+    }
+};
+
+template <typename T>
+struct IsExprI : std::false_type {};
+
+template <typename F>
+struct IsExprI<Act<F>> : std::true_type {};
+
+template <typename A, typename B>
+struct IsExprI<Seq<A, B>> : std::true_type {};
+
+// Action expressions sequenced by the comma operator
+template <typename T>
+concept Expr = IsExprI<T>::value;
+
+template <Expr A, Expr B>
+constexpr auto operator,(A a, B b) {
+    return Seq<A, B>{std::move(a), std::move(b)};
+}
+
+}  // namespace sml::impl::action
@@ -1,80 +1,624 @@
 #pragma once
 
 #include "sml/ids.h"
+#include "sml/impl/local.h"
+#include "sml/impl/progmem.h"
+#include "sml/impl/storage.h"
 #include "sml/impl/traits.h"
+#include "sml/policy.h"
 
-#include <supp/tuple.h>
 #include <supp/type_list.h>
 
 #include <array>
 #include <tuple>
+#include <utility>
 
 namespace sml::impl {
 
-template <typename EId, tl::IsList Transitions>
+template <tl::IsList Transitions>
+struct StateClasses;
+
+// Ctx is the type of the machine context passed to guards and actions, if any
+template <typename EId, tl::IsList Transitions, typename... Ctx>
 class Dispatcher {
     using StateSpecs = traits::GetStateSpecs<Transitions>;
-    using TransitionsTuple = tl::ApplyToTemplate<Transitions, std::tuple>;
 
     using EvTransitions = traits::FilterTransitionsByEventId<EId, Transitions>;
     using OutboundStateSpecs = traits::GetSrcSpecs<EvTransitions, StateSpecs>;
-
-    static constexpr size_t NumOutboundStates = tl::Size<OutboundStateSpecs>;
-    static constexpr auto StateInjection = tl::injection(StateSpecs{}, OutboundStateSpecs{});
+    using ScanStateSpecs = traits::GetScanSrcSpecs<EId, EvTransitions, OutboundStateSpecs>;
 
  public:
-    explicit Dispatcher(TransitionsTuple* ts) : transitions_{ts} {
-        supp::constexprFor<0, NumOutboundStates, 1>([this](auto I) {
-            handlers_[I] = &accept<tl::At<I, OutboundStateSpecs>>;
-        });
-    }
+    using TransitionsStorage = tl::ApplyToTemplate<Transitions, Storage>;
+    using Index = traits::StateIndex<StateSpecs>;
+
+    static constexpr Index Rejected = traits::NoState<Index>;
+
+    // Returned when a defer transition matches, never a state index either
+    static constexpr Index Deferred = Rejected - 1;
 
-    int dispatch(int state_idx, const EId& id) {
-        state_idx = static_cast<int>(StateInjection[state_idx]);
-        if (state_idx == -1) {
-            return -1;
+    template <typename Policy = policy::Table>
+    static constexpr Index dispatch(
+        TransitionsStorage& transitions,
+        Index state_idx,
+        const EId& id,
+        Ctx&... ctx) {
+        if constexpr (std::same_as<Policy, policy::Switch>) {
+            return dispatchSwitch(transitions, state_idx, id, ctx...);
+        } else if constexpr (std::same_as<Policy, policy::Dfa> && Compiled) {
+            return dispatchDfa<false>(transitions, state_idx, id, ctx...);
+        } else if constexpr (std::same_as<Policy, policy::MinimalDfa> && Compiled) {
+            return dispatchDfa<true>(transitions, state_idx, id, ctx...);
+        } else if constexpr (Lifecycle) {
+            return pgmRead(&DirectHandlers::value[state_idx])(id, transitions, ctx...);
+        } else {
+            Index handler_idx = pgmRead(&StateInjection[state_idx]);
+            if (handler_idx == Rejected) {
+                return Rejected;
+            }
+            return pgmRead(&Handlers::value[handler_idx])(id, transitions, ctx...);
         }
-        return handlers_[state_idx](id, *transitions_);
+    }
+
+    // Whether the state has transitions on EId, from a bit per state. Lets callers skip
+    // dispatching onEnter and onExit to the states that have no such transitions.
+    static constexpr bool handles(Index state_idx) {
+        return (pgmRead(&HandledMask[state_idx / 8]) >> (state_idx % 8) & 1) != 0;
+    }
+
+    // Whether the transitions on EId can be compiled into a table for policy::Dfa and
+    // policy::MinimalDfa
+    static constexpr bool Compiled = scan::IsByte<EId> && traits::AllCompiled<EvTransitions>;
+
+    struct Step {
+        Index dst;
+        bool acts;
+    };
+
+    // Entry of the compiled table for the event: the state it leads to and whether
+    // dispatching it runs actions. Runs nothing itself.
+    template <typename Policy>
+        requires Compiled
+    static constexpr Step lookup(Index state_idx, const EId& id) {
+        using Dfa = DfaI<StateSpecs, DfaSteps, std::same_as<Policy, policy::MinimalDfa>>;
+
+        auto value = static_cast<uint8_t>(id);
+        Index row = pgmRead(&Dfa::RowOf[state_idx]);
+        return {
+            pgmRead(&Dfa::Next[row][value]),
+            pgmRead(&Dfa::Action[row][value]) != NoAction,
+        };
+    }
+
+    // The state the compiled table leads to, at compile time
+    template <typename Policy>
+        requires Compiled
+    static constexpr Index compiledNext(Index state_idx, uint8_t value) {
+        using Dfa = DfaI<StateSpecs, DfaSteps, std::same_as<Policy, policy::MinimalDfa>>;
+        return Dfa::Rows[state_idx].next[value];
+    }
+
+    // Whether some state starts its transitions on EId with a scan transition
+    static constexpr bool HasScans = !tl::Empty<ScanStateSpecs>;
+
+    // Runs the leading scan transition of the state over [first, last), if any.
+    // Returns the first event that is left to dispatch.
+    static const EId* scan(
+        TransitionsStorage& transitions,
+        Index state_idx,
+        const EId* first,
+        const EId* last,
+        Ctx&... ctx) {
+        auto scanner = [&]<typename SrcSpec>(tl::Type<SrcSpec>) {
+            if (state_idx != tl::Find<SrcSpec, StateSpecs>) {
+                return false;
+            }
+
+            using Ts = traits::FilterTransitionsBySrcAndEvent<SrcSpec, EId, EvTransitions>;
+            using T = tl::At<0, Ts>;
+            first = local::scan<SrcSpec>(impl::get<T>(transitions), first, last, ctx...);
+            return true;
+        };
+
+        tl::forEachShortCircuit(scanner, ScanStateSpecs{});
+        return first;
     }
 
  private:
-    using HandlerFunc = int (*)(const EId&, TransitionsTuple&);
+    using HandlerFunc = Index (*)(const EId&, TransitionsStorage&, Ctx&...);
+
+    // onEnter and onExit are dispatched on every state change, through a handler per state
+    // rather than through the state injection
+    static constexpr bool Lifecycle =
+        std::same_as<OnEnterEventId, EId> || std::same_as<OnExitEventId, EId>;
+
+    template <typename Specs>
+    struct HandledMaskI;
+
+    template <typename... Specs>
+    struct HandledMaskI<tl::List<Specs...>> {
+        static constexpr std::array<uint8_t, (sizeof...(Specs) + 7) / 8> value SML_PROGMEM = [] {
+            constexpr std::array<bool, sizeof...(Specs)> handled{
+                tl::Contains<OutboundStateSpecs, Specs>...,
+            };
+
+            std::array<uint8_t, (sizeof...(Specs) + 7) / 8> mask{};
+            for (size_t i = 0; i < handled.size(); ++i) {
+                mask[i / 8] |= static_cast<uint8_t>(handled[i] ? 1 << (i % 8) : 0);
+            }
+            return mask;
+        }();
+    };
+
+    static constexpr auto& HandledMask = HandledMaskI<StateSpecs>::value;
+
+    static constexpr auto& StateInjection =
+        traits::Injection<Index, StateSpecs, OutboundStateSpecs>;
 
     template <typename SrcSpec>
-    static int accept(const EId& id, TransitionsTuple& transitions) {
-        int dst = -1;
+    using SrcTransitions = traits::FilterTransitionsBySrcAndEvent<SrcSpec, EId, EvTransitions>;
+
+    // Whether the state looks byte events up in a table of value guards
+    // instead of testing its transitions one by one
+    template <typename SrcSpec>
+    static constexpr bool HasValueTable = scan::IsByte<EId> &&
+        traits::CountValueGuarded<SrcTransitions<SrcSpec>> >= 2 &&
+        tl::Size<SrcTransitions<SrcSpec>> < 255;
+
+    template <typename SrcSpec>
+    static constexpr Index accept(const EId& id, TransitionsStorage& transitions, Ctx&... ctx) {
+        if constexpr (HasValueTable<SrcSpec>) {
+            using Ts = SrcTransitions<SrcSpec>;
+            uint8_t first = pgmRead(&traits::FirstCandidate<Ts>[static_cast<uint8_t>(id)]);
+            return pgmRead(&SuffixHandlers<SrcSpec>::value[first])(id, transitions, ctx...);
+        } else {
+            return acceptFrom<SrcSpec, 0>(id, transitions, ctx...);
+        }
+    }
+
+    // Tries transitions of the state starting from the First one
+    template <typename SrcSpec, size_t First>
+    static constexpr Index acceptFrom(
+        const EId& id,
+        TransitionsStorage& transitions,
+        Ctx&... ctx) {
+        using Ts = SrcTransitions<SrcSpec>;
+
+        Index dst = Rejected;
         auto matcher = [&]<Transition T>(tl::Type<T>) {
-            using SrcId = typename SrcSpec::Id;
+            if constexpr (tl::Find<T, Ts> < First) {
+                return false;
+            }
+
             using Dst = typename T::Dst;
             using DstId = typename Dst::Id;
-            using DstSpec = std::conditional_t<
-                std::same_as<KeepStateId, DstId>,
-                SrcSpec,
-                traits::StateSpec<DstId, typename Dst::Tag>>;
 
-            if (!std::get<T>(transitions).template operator()<SrcId, EId>(SrcId{}, id)) {
+            if (!local::run<SrcSpec>(impl::get<T>(transitions), id, ctx...)) {
                 return false;
             }
 
             if constexpr (std::same_as<BypassStateId, DstId>) {
                 dst = tl::Find<SrcSpec, StateSpecs>;
                 return false;
+            } else if constexpr (std::same_as<KeepStateId, DstId>) {
+                dst = tl::Find<SrcSpec, StateSpecs>;
+                return true;
+            } else if constexpr (std::same_as<DeferStateId, DstId>) {
+                dst = Deferred;
+                return true;
             } else {
+                using DstSpec = traits::StateSpec<DstId, typename Dst::Tag>;
                 static_assert(tl::Contains<StateSpecs, DstSpec>);
-                dst = tl::Find<DstSpec, StateSpecs>;
+                dst = Settled<SrcSpec, DstSpec>;
                 return true;
             }
         };
 
-        // event transitions that match source state and event id
-        using Ts = traits::FilterTransitionsBySrcAndEvent<SrcSpec, EId, EvTransitions>;
-
         tl::forEachShortCircuit(matcher, Ts{});
         return dst;
     }
 
-    TransitionsTuple* transitions_;
-    std::array<HandlerFunc, NumOutboundStates> handlers_;
+    // Index of the state transitions from SrcSpec into DstSpec lead to: past the pass-through
+    // states that would only lead on once entered, see traits::PassThrough.
+    // Kept at DstSpec if they lead back to SrcSpec, which is then left and entered again.
+    template <typename SrcSpec, typename DstSpec>
+    static constexpr Index Settled = [] {
+        constexpr Index settled = traits::Settle<Transitions>[tl::Find<DstSpec, StateSpecs>];
+        return settled == tl::Find<SrcSpec, StateSpecs> ? tl::Find<DstSpec, StateSpecs> : settled;
+    }();
+
+    // Index of the state transition T of the state leads to, or Rejected for bypass
+    template <typename SrcSpec, Transition T>
+    static constexpr Index DstIndexOf = [] {
+        using DstId = typename T::Dst::Id;
+        if constexpr (std::same_as<BypassStateId, DstId>) {
+            return Rejected;
+        } else if constexpr (std::same_as<KeepStateId, DstId>) {
+            return static_cast<Index>(tl::Find<SrcSpec, StateSpecs>);
+        } else {
+            using DstSpec = traits::StateSpec<DstId, typename T::Dst::Tag>;
+            static_assert(tl::Contains<StateSpecs, DstSpec>);
+            return Settled<SrcSpec, DstSpec>;
+        }
+    }();
+
+    // Compare chain over outbound states, which the compiler is free to turn into a switch
+    static constexpr Index dispatchSwitch(
+        TransitionsStorage& transitions,
+        Index state_idx,
+        const EId& id,
+        Ctx&... ctx) {
+        Index dst = Rejected;
+        auto matcher = [&]<typename SrcSpec>(tl::Type<SrcSpec>) {
+            if (state_idx != tl::Find<SrcSpec, StateSpecs>) {
+                return false;
+            }
+            dst = accept<SrcSpec>(id, transitions, ctx...);
+            return true;
+        };
+
+        tl::forEachShortCircuit(matcher, OutboundStateSpecs{});
+        return dst;
+    }
+
+    // Looks the next state and the action to run up in the compiled table.
+    // Actions are run by the ordinary handler starting from the first acting transition,
+    // the guards it checks again are value tests with a known outcome.
+    template <bool Merge>
+    static constexpr Index dispatchDfa(
+        TransitionsStorage& transitions,
+        Index state_idx,
+        const EId& id,
+        Ctx&... ctx) {
+        using Dfa = DfaI<StateSpecs, DfaSteps, Merge>;
+
+        auto value = static_cast<uint8_t>(id);
+        Index row = pgmRead(&Dfa::RowOf[state_idx]);
+        Index dst = pgmRead(&Dfa::Next[row][value]);
+        ActionIndex action = pgmRead(&Dfa::Action[row][value]);
+        if (action != NoAction) {
+            pgmRead(&Dfa::Handlers[action])(id, transitions, ctx...);
+        }
+        return dst;
+    }
+
+    // Transition I of the state runs actions
+    template <typename SrcSpec, size_t I>
+    struct DfaStep {};
+
+    template <typename SrcSpec, typename Is>
+    struct DfaStepsI;
+
+    template <typename SrcSpec, size_t... Is>
+    struct DfaStepsI<SrcSpec, std::index_sequence<Is...>> {
+        using Ts = SrcTransitions<SrcSpec>;
+
+        using type = tl::Flatten<tl::List<std::conditional_t<
+            traits::CompiledI<tl::At<Is, Ts>>::Acts,
+            tl::List<DfaStep<SrcSpec, Is>>,
+            tl::List<>>...>>;
+    };
+
+    struct DfaStepsMapper {
+        template <typename SrcSpec>
+        using Map = typename DfaStepsI<
+            SrcSpec,
+            std::make_index_sequence<tl::Size<SrcTransitions<SrcSpec>>>>::type;
+    };
+
+    // Acting transitions of all outbound states, the compiled table refers to them by index
+    using DfaSteps = tl::Flatten<tl::Map<DfaStepsMapper, OutboundStateSpecs>>;
+    using ActionIndex = traits::StateIndex<DfaSteps>;
+
+    static constexpr ActionIndex NoAction = traits::NoState<ActionIndex>;
+
+    struct DfaRow {
+        std::array<Index, 256> next;
+        std::array<ActionIndex, 256> action;
+
+        constexpr bool operator==(const DfaRow&) const = default;
+    };
+
+    // Runs the transitions of the state in order for each byte value
+    template <typename SrcSpec>
+    static constexpr DfaRow dfaRow() {
+        DfaRow row{};
+        row.next.fill(Rejected);
+        row.action.fill(NoAction);
+
+        if constexpr (tl::Contains<OutboundStateSpecs, SrcSpec>) {
+            using Ts = SrcTransitions<SrcSpec>;
+            constexpr auto Self = static_cast<Index>(tl::Find<SrcSpec, StateSpecs>);
+
+            [&]<size_t... Is>(std::index_sequence<Is...>) {
+                constexpr size_t N = sizeof...(Is);
+                constexpr std::array<guard::ByteSet, N> values{
+                    traits::CompiledI<tl::At<Is, Ts>>::Values...};
+                constexpr std::array<bool, N> acts{traits::CompiledI<tl::At<Is, Ts>>::Acts...};
+                constexpr std::array<Index, N> dsts{DstIndexOf<SrcSpec, tl::At<Is, Ts>>...};
+                constexpr std::array<ActionIndex, N> steps{static_cast<ActionIndex>(
+                    tl::Find<DfaStep<SrcSpec, Is>, DfaSteps>)...};
+
+                for (unsigned b = 0; b < 256; ++b) {
+                    for (size_t i = 0; i < N; ++i) {
+                        if (!values[i].contains(b)) {
+                            continue;
+                        }
+                        if (acts[i] && row.action[b] == NoAction) {
+                            row.action[b] = steps[i];
+                        }
+                        if (dsts[i] == Rejected) {
+                            row.next[b] = Self;  // bypass
+                            continue;
+                        }
+                        row.next[b] = dsts[i];
+                        break;
+                    }
+                }
+            }(std::make_index_sequence<tl::Size<Ts>>{});
+        }
+
+        return row;
+    }
+
+    // Compiled table over all states, kept in flash on AVR.
+    // States with equal rows share one, with Merge equivalent states are merged first.
+    template <tl::IsList Specs, tl::IsList Steps, bool Merge>
+    struct DfaI;
+
+    template <typename... Specs, typename... SrcSpecs, size_t... Is, bool Merge>
+    struct DfaI<tl::List<Specs...>, tl::List<DfaStep<SrcSpecs, Is>...>, Merge> {
+        static constexpr size_t N = sizeof...(Specs);
+
+        static constexpr std::array<DfaRow, N> Rows = [] {
+            std::array<DfaRow, N> rows{dfaRow<Specs>()...};
+            if constexpr (Merge) {
+                for (auto& row : rows) {
+                    for (auto& next : row.next) {
+                        if (next != Rejected) {
+                            next = StateClasses<Transitions>::Representative[next];
+                        }
+                    }
+                }
+            }
+            return rows;
+        }();
+
+        // Index of the first row equal to each row
+        static constexpr std::array<size_t, N> FirstEqual = [] {
+            std::array<size_t, N> first{};
+            for (size_t i = 0; i < N; ++i) {
+                first[i] = i;
+                for (size_t j = 0; j < i; ++j) {
+                    if (first[j] == j && Rows[j] == Rows[i]) {
+                        first[i] = j;
+                        break;
+                    }
+                }
+            }
+            return first;
+        }();
+
+        static constexpr size_t UniqueRows = [] {
+            size_t count = 0;
+            for (size_t i = 0; i < N; ++i) {
+                count += FirstEqual[i] == i;
+            }
+            return count;
+        }();
+
+        static constexpr std::array<Index, N> RowOf SML_PROGMEM = [] {
+            std::array<Index, N> row_of{};
+            Index unique = 0;
+            for (size_t i = 0; i < N; ++i) {
+                row_of[i] = FirstEqual[i] == i ? unique++ : row_of[FirstEqual[i]];
+            }
+            return row_of;
+        }();
+
+        static constexpr std::array<std::array<Index, 256>, UniqueRows> Next SML_PROGMEM = [] {
+            std::array<std::array<Index, 256>, UniqueRows> next{};
+            for (size_t i = 0; i < N; ++i) {
+                next[RowOf[i]] = Rows[i].next;
+            }
+            return next;
+        }();
+
+        static constexpr std::array<std::array<ActionIndex, 256>, UniqueRows> Action
+            SML_PROGMEM = [] {
+                std::array<std::array<ActionIndex, 256>, UniqueRows> action{};
+                for (size_t i = 0; i < N; ++i) {
+                    action[RowOf[i]] = Rows[i].action;
+                }
+                return action;
+            }();
+
+        static constexpr std::array<HandlerFunc, sizeof...(Is)> Handlers SML_PROGMEM = {
+            &acceptFrom<SrcSpecs, Is>...,
+        };
+    };
+
+    template <tl::IsList>
+    friend struct StateClasses;
+
+    // One handler per outbound state, shared by all instances and kept in flash on AVR
+    template <tl::IsList Specs>
+    struct HandlersI;
+
+    template <typename... Specs>
+    struct HandlersI<tl::List<Specs...>> {
+        static constexpr std::array<HandlerFunc, sizeof...(Specs)> value SML_PROGMEM = {
+            &accept<Specs>...,
+        };
+    };
+
+    using Handlers = HandlersI<OutboundStateSpecs>;
+
+    static constexpr Index reject(const EId&, TransitionsStorage&, Ctx&...) {
+        return Rejected;
+    }
+
+    // One handler per state, rejecting for the states without transitions on EId
+    template <tl::IsList Specs>
+    struct DirectHandlersI;
+
+    template <typename... Specs>
+    struct DirectHandlersI<tl::List<Specs...>> {
+        template <typename Spec>
+        static constexpr HandlerFunc handlerOf() {
+            if constexpr (tl::Contains<OutboundStateSpecs, Spec>) {
+                return &accept<Spec>;
+            } else {
+                return &reject;
+            }
+        }
+
+        static constexpr std::array<HandlerFunc, sizeof...(Specs)> value SML_PROGMEM = {
+            handlerOf<Specs>()...,
+        };
+    };
+
+    using DirectHandlers = DirectHandlersI<StateSpecs>;
+
+    // One handler per first candidate transition of the state, the last one rejects
+    template <typename SrcSpec, typename Is>
+    struct SuffixHandlersI;
+
+    template <typename SrcSpec, size_t... Is>
+    struct SuffixHandlersI<SrcSpec, std::index_sequence<Is...>> {
+        static constexpr std::array<HandlerFunc, sizeof...(Is)> value SML_PROGMEM = {
+            &acceptFrom<SrcSpec, Is>...,
+        };
+    };
+
+    template <typename SrcSpec>
+    using SuffixHandlers = SuffixHandlersI<
+        SrcSpec,
+        std::make_index_sequence<tl::Size<SrcTransitions<SrcSpec>> + 1>>;
+};
+
+// Classes of states that no event tells apart, for policy::MinimalDfa.
+// A state may share its class when it is not terminal, runs no actions, only has
+// transitions on compiled byte events and has no local data (see sml::Local).
+// Such states are equivalent when they lead to equivalent states for all values
+// of those events (Moore's partition refinement).
+// Representative maps each state index to the least index of its class.
+template <tl::IsList Transitions>
+struct StateClasses {
+ private:
+    using StateSpecs = traits::GetStateSpecs<Transitions>;
+    using EIds = traits::GetEventIds<Transitions>;
+    using Index = traits::StateIndex<StateSpecs>;
+
+    static constexpr Index Rejected = traits::NoState<Index>;
+
+    template <typename Spec, typename EId>
+    static constexpr bool MergeableOn = [] {
+        using Disp = Dispatcher<EId, Transitions>;
+        using Ts = typename Disp::template SrcTransitions<Spec>;
+
+        if constexpr (tl::Empty<Ts>) {
+            return true;
+        } else if constexpr (Disp::Compiled) {
+            return []<typename... Ts_>(tl::List<Ts_...>) {
+                return !(traits::CompiledI<Ts_>::Acts || ...);
+            }(Ts{});
+        } else {
+            return false;
+        }
+    }();
+
+    // Local data, onEnter and onExit tell states apart even when no event does
+    template <typename EId, typename Spec>
+    using SrcTransitions = typename Dispatcher<EId, Transitions>::template SrcTransitions<Spec>;
+
+    template <typename Spec>
+    static constexpr bool Plain = !std::derived_from<typename Spec::Id, Local> &&
+                                  !std::derived_from<typename Spec::Tag, Local> &&
+                                  tl::Empty<SrcTransitions<OnEnterEventId, Spec>> &&
+                                  tl::Empty<SrcTransitions<OnExitEventId, Spec>>;
+
+    template <typename Spec, tl::IsList Events>
+    struct MergeableI;
+
+    template <typename Spec, typename... Events>
+    struct MergeableI<Spec, tl::List<Events...>> {
+        static constexpr bool value = !std::same_as<TerminalStateId, typename Spec::Id> &&
+                                      Plain<Spec> && (MergeableOn<Spec, Events>&&...);
+    };
+
+    struct IsCompiled {
+        template <typename EId>
+        static constexpr bool test() {
+            return Dispatcher<EId, Transitions>::Compiled;
+        }
+    };
+
+    using CompiledEIds = tl::Filter<IsCompiled, EIds>;
+
+    template <tl::IsList Specs, tl::IsList Events>
+    struct ClassesI;
+
+    template <typename... Specs, typename... Events>
+    struct ClassesI<tl::List<Specs...>, tl::List<Events...>> {
+        static constexpr size_t N = sizeof...(Specs);
+        using Rows = std::array<std::array<Index, 256>, N>;
+
+        template <typename EId>
+        static constexpr Rows nextRows() {
+            return {Dispatcher<EId, Transitions>::template dfaRow<Specs>().next...};
+        }
+
+        static constexpr std::array<Index, N> value = [] {
+            constexpr std::array<bool, N> mergeable{MergeableI<Specs, EIds>::value...};
+            constexpr std::array<Rows, sizeof...(Events)> rows{nextRows<Events>()...};
+
+            std::array<Index, N> cls{};
+            Index first_mergeable = Rejected;
+            for (size_t i = 0; i < N; ++i) {
+                if (mergeable[i] && first_mergeable == Rejected) {
+                    first_mergeable = static_cast<Index>(i);
+                }
+                cls[i] = mergeable[i] ? first_mergeable : static_cast<Index>(i);
+            }
+
+            auto equivalent = [&](size_t i, size_t j) {
+                for (const auto& next : rows) {
+                    for (size_t b = 0; b < 256; ++b) {
+                        Index a = next[i][b];
+                        Index c = next[j][b];
+                        if (a == Rejected || c == Rejected ? a != c : cls[a] != cls[c]) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            };
+
+            for (bool changed = true; changed;) {
+                std::array<Index, N> refined{};
+                for (size_t i = 0; i < N; ++i) {
+                    refined[i] = static_cast<Index>(i);
+                    if (!mergeable[i]) {
+                        continue;
+                    }
+                    for (size_t j = 0; j < i; ++j) {
+                        if (refined[j] == j && cls[j] == cls[i] && equivalent(i, j)) {
+                            refined[i] = static_cast<Index>(j);
+                            break;
+                        }
+                    }
+                }
+                changed = refined != cls;
+                cls = refined;
+            }
+
+            return cls;
+        }();
+    };
+
+ public:
+    static constexpr std::array<Index, tl::Size<StateSpecs>> Representative SML_PROGMEM =
+        ClassesI<StateSpecs, CompiledEIds>::value;
 };
 
 }  // namespace sml::impl
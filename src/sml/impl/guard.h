@@ -0,0 +1,226 @@
+#pragma once
+
+#include "sml/impl/invoke.h"
+#include "sml/impl/scan.h"
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+namespace sml::impl::guard {
+
+// Set of byte values, usable as a template argument
+struct ByteSet {
+    std::array<uint64_t, 4> words{};
+
+    static constexpr ByteSet all() {
+        return ~ByteSet{};
+    }
+
+    static constexpr ByteSet range(uint8_t lo, uint8_t hi) {
+        ByteSet s;
+        for (unsigned b = lo; b <= hi; ++b) {
+            s.words[b / 64] |= uint64_t{1} << (b % 64);
+        }
+        return s;
+    }
+
+    template <typename... Bs>
+    static constexpr ByteSet of(Bs... bs) {
+        return (ByteSet{} | ... | range(static_cast<uint8_t>(bs), static_cast<uint8_t>(bs)));
+    }
+
+    constexpr bool contains(uint8_t b) const {
+        return (words[b / 64] >> (b % 64)) & 1;
+    }
+
+    constexpr bool operator==(const ByteSet&) const = default;
+
+    friend constexpr ByteSet operator|(ByteSet a, const ByteSet& b) {
+        for (size_t i = 0; i < a.words.size(); ++i) {
+            a.words[i] |= b.words[i];
+        }
+        return a;
+    }
+
+    friend constexpr ByteSet operator&(ByteSet a, const ByteSet& b) {
+        for (size_t i = 0; i < a.words.size(); ++i) {
+            a.words[i] &= b.words[i];
+        }
+        return a;
+    }
+
+    friend constexpr ByteSet operator~(ByteSet a) {
+        for (auto& w : a.words) {
+            w = ~w;
+        }
+        return a;
+    }
+};
+
+// String literal usable as a template argument
+template <size_t N>
+struct Chars {
+    char data[N];
+
+    constexpr Chars(const char (&s)[N]) {  // NOLINT
+        for (size_t i = 0; i < N; ++i) {
+            data[i] = s[i];
+        }
+    }
+
+    constexpr ByteSet set() const {
+        ByteSet s;
+        for (size_t i = 0; i + 1 < N; ++i) {
+            s = s | ByteSet::of(data[i]);
+        }
+        return s;
+    }
+};
+
+// Guard accepting byte events with values in Set.
+// The set is known at compile time, so the dispatcher can look the event up in a table.
+template <ByteSet Set>
+struct In {
+    static constexpr ByteSet Values = Set;
+
+    template <typename SId, typename E>
+    constexpr bool operator()(SId&&, const E& e) const {
+        static_assert(scan::IsByte<E>, "value guards apply to byte events only");
+        return Set.contains(static_cast<uint8_t>(e));
+    }
+};
+
+// Arbitrary guard lifted into the guard algebra
+template <typename F>
+struct Pred {
+    [[no_unique_address]] F f;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        return invoke(f, sid, e, ctx...);
+    }
+};
+
+template <typename A, typename B>
+struct And {
+    [[no_unique_address]] A a;
+    [[no_unique_address]] B b;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        return invoke(a, sid, e, ctx...) && invoke(b, sid, e, ctx...);
+    }
+};
+
+template <typename A, typename B>
+struct Or {
+    [[no_unique_address]] A a;
+    [[no_unique_address]] B b;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        return invoke(a, sid, e, ctx...) || invoke(b, sid, e, ctx...);
+    }
+};
+
+template <typename A>
+struct Not {
+    [[no_unique_address]] A a;
+
+    template <typename SId, typename E, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const E& e, Ctx&... ctx) {
+        return !invoke(a, sid, e, ctx...);
+    }
+};
+
+// Byte values an event must have for guard G to accept it, and whether G is
+// a pure value test, so that values outside the set are rejected without calls.
+template <typename G>
+struct ValuesI {
+    static constexpr ByteSet Values = ByteSet::all();
+    static constexpr bool Pure = false;
+};
+
+template <ByteSet Set>
+struct ValuesI<In<Set>> {
+    static constexpr ByteSet Values = Set;
+    static constexpr bool Pure = true;
+};
+
+template <typename A, typename B>
+struct ValuesI<And<A, B>> {
+    static constexpr bool Pure = ValuesI<A>::Pure && ValuesI<B>::Pure;
+    static constexpr ByteSet Values =
+        ValuesI<A>::Pure ? ValuesI<A>::Values & ValuesI<B>::Values : ValuesI<A>::Values;
+};
+
+template <typename A, typename B>
+struct ValuesI<Or<A, B>> {
+    static constexpr bool Pure = ValuesI<A>::Pure && ValuesI<B>::Pure;
+    static constexpr ByteSet Values = ValuesI<A>::Values | ValuesI<B>::Values;
+};
+
+template <typename A>
+struct ValuesI<Not<A>> {
+    static constexpr bool Pure = ValuesI<A>::Pure;
+    static constexpr ByteSet Values = Pure ? ~ValuesI<A>::Values : ByteSet::all();
+};
+
+template <typename T>
+struct IsExprI : std::false_type {};
+
+template <ByteSet Set>
+struct IsExprI<In<Set>> : std::true_type {};
+
+template <typename F>
+struct IsExprI<Pred<F>> : std::true_type {};
+
+template <typename A, typename B>
+struct IsExprI<And<A, B>> : std::true_type {};
+
+template <typename A, typename B>
+struct IsExprI<Or<A, B>> : std::true_type {};
+
+template <typename A>
+struct IsExprI<Not<A>> : std::true_type {};
+
+// Guard expressions combined by the operators below
+template <typename T>
+concept Expr = IsExprI<T>::value;
+
+// Value tests fold into a single set, anything else builds an expression
+
+template <ByteSet A, ByteSet B>
+constexpr auto operator&&(In<A>, In<B>) {
+    return In<A & B>{};
+}
+
+template <ByteSet A, ByteSet B>
+constexpr auto operator||(In<A>, In<B>) {
+    return In<A | B>{};
+}
+
+template <ByteSet A>
+constexpr auto operator!(In<A>) {
+    return In<~A>{};
+}
+
+template <Expr A, Expr B>
+constexpr auto operator&&(A a, B b) {
+    return And<A, B>{std::move(a), std::move(b)};
+}
+
+template <Expr A, Expr B>
+constexpr auto operator||(A a, B b) {
+    return Or<A, B>{std::move(a), std::move(b)};
+}
+
+template <Expr A>
+constexpr auto operator!(A a) {
+    return Not<A>{std::move(a)};
+}
+
+}  // namespace sml::impl::guard
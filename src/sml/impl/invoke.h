@@ -0,0 +1,32 @@
+#pragma once
+
+#include <type_traits>
+
+namespace sml::impl {
+
+// Calls guard or action f, passing the machine context to the ones that take it
+template <typename F, typename SId, typename E, typename... Ctx>
+constexpr decltype(auto) invoke(F&& f, SId& sid, const E& e, Ctx&... ctx) {
+    if constexpr (sizeof...(Ctx) != 0 && std::is_invocable_v<F&, SId&, const E&, Ctx&...>) {
+        return f(sid, e, ctx...);
+    } else {
+        return f(sid, e);
+    }
+}
+
+// Passes the machine context and the queue of raised events to the ones that take them,
+// in this order
+template <typename F, typename SId, typename E, typename Ctx, typename Raised>
+constexpr decltype(auto) invoke(F&& f, SId& sid, const E& e, Ctx& ctx, Raised& raised) {
+    if constexpr (std::is_invocable_v<F&, SId&, const E&, Ctx&, Raised&>) {
+        return f(sid, e, ctx, raised);
+    } else if constexpr (std::is_invocable_v<F&, SId&, const E&, Ctx&>) {
+        return f(sid, e, ctx);
+    } else if constexpr (std::is_invocable_v<F&, SId&, const E&, Raised&>) {
+        return f(sid, e, raised);
+    } else {
+        return f(sid, e);
+    }
+}
+
+}  // namespace sml::impl
@@ -0,0 +1,406 @@
+#pragma once
+
+#include "sml/ids.h"
+#include "sml/impl/make.h"
+#include "sml/model.h"
+
+#include <supp/type_list.h>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+#include <stddef.h>
+
+namespace sml::impl::local {
+
+template <typename T>
+constexpr bool IsLocal = std::derived_from<T, Local>;
+
+// Machine the transition was declared in
+template <typename T>
+struct OwnerI;
+
+template <typename T, typename Tag>
+struct OwnerI<transition::Tagged<T, Tag>> {
+    using type = Tag;
+};
+
+constexpr size_t alignUp(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+template <typename T>
+void construct(std::byte* at) {
+    ::new (static_cast<void*>(at)) T{};
+}
+
+template <typename T>
+void destroy(std::byte* at) {
+    std::launder(reinterpret_cast<T*>(at))->~T();
+}
+
+using Op = void (*)(std::byte*);
+
+// Storage of local data, see sml::Local. Copied bytewise, not copyable at all
+// if the data is not trivially copyable.
+template <size_t Size, size_t Align, bool Copyable>
+struct Arena {
+    alignas(Align) std::byte bytes[Size];
+};
+
+template <size_t Size, size_t Align>
+struct Arena<Size, Align, false> {
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    alignas(Align) std::byte bytes[Size];
+};
+
+struct NoArena {
+    static constexpr std::byte* bytes = nullptr;
+};
+
+// Place of the local data of the states and submachines of machine TM in one arena.
+// Data of a submachine follows the data of the machine it is entered from, data of
+// a state follows the data of its machine, so that data of states and submachines
+// that are never active at once overlaps.
+template <StateMachine TM, tl::IsList Transitions, tl::IsList StateSpecs>
+class Layout {
+    struct TagMapper {
+        template <typename Spec>
+        using Map = typename Spec::Tag;
+    };
+
+    using Machines = tl::Unique<tl::PushFront<tl::Map<TagMapper, StateSpecs>, TM>>;
+
+    static constexpr size_t K = tl::Size<Machines>;
+    static constexpr size_t N = tl::Size<StateSpecs>;
+
+    static constexpr size_t NoParent = K;
+    static constexpr size_t ManyParents = K + 1;
+
+    template <typename M>
+    static constexpr size_t MachineIndex = tl::Contains<Machines, M> ? tl::Find<M, Machines> : K;
+
+    template <typename T>
+    static constexpr size_t SizeOf = IsLocal<T> ? sizeof(T) : 0;
+
+    template <typename T>
+    static constexpr size_t AlignOf = IsLocal<T> ? alignof(T) : 1;
+
+    template <typename T>
+    static constexpr Op constructOf() {
+        if constexpr (IsLocal<T>) {
+            return &construct<T>;
+        } else {
+            return nullptr;
+        }
+    }
+
+    template <typename T>
+    static constexpr Op destroyOf() {
+        if constexpr (IsLocal<T> && !std::is_trivially_destructible_v<T>) {
+            return &destroy<T>;
+        } else {
+            return nullptr;
+        }
+    }
+
+    template <tl::IsList Ms>
+    struct MachinesI;
+
+    template <typename... Ms>
+    struct MachinesI<tl::List<Ms...>> {
+        static constexpr std::array<size_t, K> Size{SizeOf<Ms>...};
+        static constexpr std::array<size_t, K> Align{AlignOf<Ms>...};
+        static constexpr std::array<Op, K> Construct{constructOf<Ms>()...};
+        static constexpr std::array<Op, K> Destroy{destroyOf<Ms>()...};
+        static constexpr bool Any = (IsLocal<Ms> || ...);
+        static constexpr bool Trivial = ((!IsLocal<Ms> || std::is_trivially_copyable_v<Ms>) && ...);
+        static constexpr bool TriviallyDestructible =
+            ((!IsLocal<Ms> || std::is_trivially_destructible_v<Ms>) && ...);
+    };
+
+    template <tl::IsList Specs>
+    struct StatesI;
+
+    template <typename... Specs>
+    struct StatesI<tl::List<Specs...>> {
+        static constexpr std::array<size_t, N> Size{SizeOf<typename Specs::Id>...};
+        static constexpr std::array<size_t, N> Align{AlignOf<typename Specs::Id>...};
+        static constexpr std::array<size_t, N> Machine{MachineIndex<typename Specs::Tag>...};
+        static constexpr std::array<Op, N> Construct{constructOf<typename Specs::Id>()...};
+        static constexpr std::array<Op, N> Destroy{destroyOf<typename Specs::Id>()...};
+        static constexpr bool Any = (IsLocal<typename Specs::Id> || ...);
+        static constexpr bool Trivial =
+            ((!IsLocal<typename Specs::Id> || std::is_trivially_copyable_v<typename Specs::Id>) &&
+             ...);
+        static constexpr bool TriviallyDestructible =
+            ((!IsLocal<typename Specs::Id> ||
+              std::is_trivially_destructible_v<typename Specs::Id>) &&
+             ...);
+    };
+
+    // Machine each transition is declared in and the machine it leads to
+    template <tl::IsList Ts>
+    struct EdgesI;
+
+    template <typename... Ts>
+    struct EdgesI<tl::List<Ts...>> {
+        static constexpr std::array<size_t, sizeof...(Ts)> From{
+            MachineIndex<typename OwnerI<Ts>::type>...};
+        static constexpr std::array<size_t, sizeof...(Ts)> To{
+            MachineIndex<typename Ts::Dst::Tag>...};
+    };
+
+    using MachineInfo = MachinesI<Machines>;
+    using StateInfo = StatesI<StateSpecs>;
+    using Edges = EdgesI<Transitions>;
+
+    // Machine each submachine is entered from
+    static constexpr std::array<size_t, K> Parent = [] {
+        std::array<size_t, K> parent{};
+        parent.fill(NoParent);
+        for (size_t i = 0; i < Edges::From.size(); ++i) {
+            size_t from = Edges::From[i];
+            size_t to = Edges::To[i];
+            if (from == to || to >= K || to == MachineIndex<TM>) {
+                continue;
+            }
+            parent[to] = parent[to] == NoParent || parent[to] == from ? from : ManyParents;
+        }
+        return parent;
+    }();
+
+    static constexpr std::array<size_t, K> MachineOffset = [] {
+        std::array<size_t, K> offset{};
+        for (size_t depth = 0; depth < K; ++depth) {
+            for (size_t m = 0; m < K; ++m) {
+                size_t p = Parent[m];
+                size_t end = p < K ? offset[p] + MachineInfo::Size[p] : 0;
+                offset[m] = alignUp(end, MachineInfo::Align[m]);
+            }
+        }
+        return offset;
+    }();
+
+    static constexpr std::array<size_t, N> StateOffset = [] {
+        std::array<size_t, N> offset{};
+        for (size_t s = 0; s < N; ++s) {
+            size_t m = StateInfo::Machine[s];
+            offset[s] = alignUp(MachineOffset[m] + MachineInfo::Size[m], StateInfo::Align[s]);
+        }
+        return offset;
+    }();
+
+    // Whether machine m is machine inner or is active whenever it is
+    static constexpr bool encloses(size_t m, size_t inner) {
+        for (; inner < K; inner = Parent[inner]) {
+            if (inner == m) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void constructMachine(std::byte* arena, size_t m) {
+        if (Op op = MachineInfo::Construct[m]) {
+            op(arena + MachineOffset[m]);
+        }
+    }
+
+    static void destroyMachine(std::byte* arena, size_t m) {
+        if (Op op = MachineInfo::Destroy[m]) {
+            op(arena + MachineOffset[m]);
+        }
+    }
+
+ public:
+    static constexpr bool Any = MachineInfo::Any || StateInfo::Any;
+
+    // Whether the data can be copied bytewise
+    static constexpr bool Trivial = MachineInfo::Trivial && StateInfo::Trivial;
+
+    static constexpr bool TriviallyDestructible =
+        MachineInfo::TriviallyDestructible && StateInfo::TriviallyDestructible;
+
+    // Whether every submachine is entered from a single machine, so that the
+    // submachines active with each state are known
+    static constexpr bool Nested = [] {
+        for (size_t p : Parent) {
+            if (p == ManyParents) {
+                return false;
+            }
+        }
+        return true;
+    }();
+
+    static constexpr size_t Size = [] {
+        size_t size = 0;
+        for (size_t m = 0; m < K; ++m) {
+            size = std::max(size, MachineOffset[m] + MachineInfo::Size[m]);
+        }
+        for (size_t s = 0; s < N; ++s) {
+            size = std::max(size, StateOffset[s] + StateInfo::Size[s]);
+        }
+        return size;
+    }();
+
+    static constexpr size_t Align = [] {
+        size_t align = 1;
+        for (size_t a : MachineInfo::Align) {
+            align = std::max(align, a);
+        }
+        for (size_t a : StateInfo::Align) {
+            align = std::max(align, a);
+        }
+        return align;
+    }();
+
+    using Storage = std::conditional_t<Size == 0, NoArena, Arena<Size, Align, Trivial>>;
+
+    static constexpr bool IsRoot = IsLocal<TM>;
+
+    // Data of state Spec, which must be the current one
+    template <typename Spec>
+    static typename Spec::Id& state(std::byte* arena) {
+        constexpr size_t Offset = StateOffset[tl::Find<Spec, StateSpecs>];
+        return *std::launder(reinterpret_cast<typename Spec::Id*>(arena + Offset));
+    }
+
+    // Data of state Spec if it is the current one
+    template <typename Spec>
+    static typename Spec::Id* stateIf(std::byte* arena, size_t current) {
+        if constexpr (IsLocal<typename Spec::Id> && tl::Contains<StateSpecs, Spec>) {
+            if (current == tl::Find<Spec, StateSpecs>) {
+                return &state<Spec>(arena);
+            }
+        }
+        return nullptr;
+    }
+
+    // Data of submachine M if it is active with the current state
+    template <typename M>
+    static M* machineIf(std::byte* arena, size_t current) {
+        constexpr size_t Index = MachineIndex<M>;
+        if constexpr (IsLocal<M> && Index < K) {
+            for (size_t m = StateInfo::Machine[current]; m < K; m = Parent[m]) {
+                if (m == Index) {
+                    return std::launder(reinterpret_cast<M*>(arena + MachineOffset[m]));
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Destroys the data of state from and of the submachines it leaves for state to
+    static void leave(std::byte* arena, size_t from, size_t to) {
+        if (Op op = StateInfo::Destroy[from]) {
+            op(arena + StateOffset[from]);
+        }
+
+        size_t m_to = StateInfo::Machine[to];
+        for (size_t m = StateInfo::Machine[from]; m < K && !encloses(m, m_to); m = Parent[m]) {
+            destroyMachine(arena, m);
+        }
+    }
+
+    // Constructs the data of the submachines state to enters from state from, outermost
+    // first, and its own
+    static void enter(std::byte* arena, size_t from, size_t to) {
+        std::array<size_t, K> entered{};
+        size_t count = 0;
+        size_t m_from = StateInfo::Machine[from];
+        for (size_t m = StateInfo::Machine[to]; m < K && !encloses(m, m_from); m = Parent[m]) {
+            entered[count++] = m;
+        }
+        while (count != 0) {
+            constructMachine(arena, entered[--count]);
+        }
+
+        if (Op op = StateInfo::Construct[to]) {
+            op(arena + StateOffset[to]);
+        }
+    }
+
+    // Constructs the data of the initial state
+    static void begin(std::byte* arena, size_t initial) {
+        if (Op op = StateInfo::Construct[initial]) {
+            op(arena + StateOffset[initial]);
+        }
+    }
+
+    // Destroys the data of the current state and of the submachines active with it
+    static void end(std::byte* arena, size_t current) {
+        if (Op op = StateInfo::Destroy[current]) {
+            op(arena + StateOffset[current]);
+        }
+        for (size_t m = StateInfo::Machine[current]; m < K; m = Parent[m]) {
+            destroyMachine(arena, m);
+        }
+    }
+};
+
+// What the dispatcher passes to transitions of machines with local data:
+// the arena and what guards and actions take after the state and the event
+template <typename Layout, typename... Deps>
+struct Env {
+    std::byte* arena;
+    std::tuple<Deps&...> deps;
+
+    // Calls f with the state argument of state Spec, its data if it has any,
+    // followed by the rest
+    template <typename Spec, typename F>
+    decltype(auto) apply(F&& f) {
+        using Id = typename Spec::Id;
+        if constexpr (IsLocal<Id>) {
+            return with(Layout::template state<Spec>(arena), f);
+        } else {
+            Id sid{};
+            return with(sid, f);
+        }
+    }
+
+ private:
+    template <typename Id, typename F>
+    decltype(auto) with(Id& sid, F& f) {
+        return std::apply([&](Deps&... rest) -> decltype(auto) { return f(sid, rest...); }, deps);
+    }
+};
+
+// Runs transition t of state SrcSpec on the event
+template <typename SrcSpec, typename T, typename EId, typename... Ctx>
+constexpr bool run(T& t, const EId& id, Ctx&... ctx) {
+    using SrcId = typename SrcSpec::Id;
+    SrcId sid{};
+    return t.template operator()<SrcId&, EId>(sid, id, ctx...);
+}
+
+template <typename SrcSpec, typename T, typename EId, typename L, typename... Deps>
+bool run(T& t, const EId& id, Env<L, Deps...>& env) {
+    using SrcId = typename SrcSpec::Id;
+    return env.template apply<SrcSpec>([&](SrcId& sid, auto&... ctx) {
+        return t.template operator()<SrcId&, EId>(sid, id, ctx...);
+    });
+}
+
+// Runs scan transition t of state SrcSpec over [first, last)
+template <typename SrcSpec, typename T, typename EId, typename... Ctx>
+const EId* scan(T& t, const EId* first, const EId* last, Ctx&... ctx) {
+    typename SrcSpec::Id sid{};
+    return t.scan(sid, first, last, ctx...);
+}
+
+template <typename SrcSpec, typename T, typename EId, typename L, typename... Deps>
+const EId* scan(T& t, const EId* first, const EId* last, Env<L, Deps...>& env) {
+    return env.template apply<SrcSpec>([&](auto& sid, auto&... ctx) {
+        return t.scan(sid, first, last, ctx...);
+    });
+}
+
+}  // namespace sml::impl::local
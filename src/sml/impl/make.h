@@ -1,10 +1,14 @@
 #pragma once
 
 #include "sml/ids.h"
+#include "sml/impl/invoke.h"
+#include "sml/impl/scan.h"
 #include "sml/model.h"
 
 #include <supp/type_list.h>
 
+#include <type_traits>
+
 namespace sml::impl {
 
 namespace transition {
@@ -18,38 +22,76 @@ struct When;
 template <typename T, typename D>
 struct To;
 
+template <typename T, typename S>
+struct Scan;
+
+// Holds a part of the transition Owner. Empty parts that are trivially default constructible
+// (captureless lambdas, value guards, stateless transitions) are not stored but made on use:
+// equal empty subobjects of different transitions would not share an address and take space.
+template <
+    typename T,
+    typename Owner,
+    bool Stateless = std::is_empty_v<T> && std::is_trivially_default_constructible_v<T>>
+struct Slot {
+    constexpr explicit Slot(T value) : value_{std::move(value)} {}
+
+    constexpr T& get() {
+        return value_;
+    }
+
+ private:
+    T value_;
+};
+
+template <typename T, typename Owner>
+struct Slot<T, Owner, true> {
+    constexpr Slot() = default;
+    constexpr explicit Slot(T) {}
+
+    static constexpr T get() {
+        return T{};
+    }
+};
+
 template <typename Self>
 struct Mixin {
     template <DstState S>
-    auto operator=(S dst) && {  // NOLINT
+    constexpr auto operator=(S dst) && {  // NOLINT
         return std::move(*static_cast<Self*>(this)).to(std::move(dst));
     }
 
     template <typename A>
-    auto operator!=(A action) && {
+    constexpr auto operator!=(A action) && {
         return std::move(*static_cast<Self*>(this)).run(std::move(action));
     }
 
     template <typename A>
-    auto operator==(A action) && {
+    constexpr auto operator==(A action) && {
         return std::move(*static_cast<Self*>(this)).when(std::move(action));
     }
 
     template <DstState Dst>
-    auto to(Dst) && {
+    constexpr auto to(Dst) && {
         return To<Self, Dst>{std::move(*static_cast<Self*>(this))};
     }
 
     template <typename Action>
-    auto run(Action a) && {
-        return Run<Self, Action>{
-            std::move(*static_cast<Self*>(this)),
-            std::move(a),
-        };
+    constexpr auto run(Action a) && {
+        if constexpr (scan::IsUntil<Action>) {
+            return Scan<Self, Action>{
+                std::move(*static_cast<Self*>(this)),
+                std::move(a),
+            };
+        } else {
+            return Run<Self, Action>{
+                std::move(*static_cast<Self*>(this)),
+                std::move(a),
+            };
+        }
     }
 
     template <typename Condition>
-    auto when(Condition c) && {
+    constexpr auto when(Condition c) && {
         return When<Self, Condition>{
             std::move(*static_cast<Self*>(this)),
             std::move(c),
@@ -71,20 +113,21 @@ struct To : Mixin<To<T, D>> {
     using Event = typename T::Event;
     using Mixin<To<T, D>>::operator=;
 
-    explicit To(T parent) : parent_{std::move(parent)} {}
+    constexpr To() = default;
+    constexpr explicit To(T parent) : parent_{std::move(parent)} {}
 
     template <DstState Dest>
-    auto to(Dest) && {
-        return To<T, Dest>{std::move(parent_)};
+    constexpr auto to(Dest) && {
+        return To<T, Dest>{std::move(parent_.get())};
     }
 
-    template <typename SId, typename EId>
-    bool operator()(SId sid, const EId& eid) {
-        return parent_(sid, eid);
+    template <typename SId, typename EId, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const EId& eid, Ctx&... ctx) {
+        return parent_.get()(sid, eid, ctx...);
     }
 
  private:
-    T parent_;
+    [[no_unique_address]] Slot<T, To> parent_;
 };
 
 template <typename T, typename A>
@@ -94,21 +137,64 @@ struct Run : Mixin<Run<T, A>> {
     using Event = typename T::Event;
     using Mixin<Run<T, A>>::operator=;
 
-    Run(T parent, A action) : parent_{std::move(parent)}, action_{std::move(action)} {}
+    constexpr Run() = default;
+    constexpr Run(T parent, A action)
+        : parent_{std::move(parent)}
+        , action_{std::move(action)} {}
+
+    template <typename SId, typename EId, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const EId& eid, Ctx&... ctx) {
+        if (!parent_.get()(sid, eid, ctx...)) {
+            return false;
+        }
+
+        invoke(action_.get(), sid, eid, ctx...);
+        return true;
+    }
+
+ private:
+    [[no_unique_address]] Slot<T, Run> parent_;
+    [[no_unique_address]] Slot<A, Run> action_;
+};
+
+// Consumes events that are not delimiters of the scanner S.
+// Fed a contiguous run of events, consumes it up to the first delimiter at once.
+template <typename T, typename S>
+struct Scan : Mixin<Scan<T, S>> {
+    using Src = typename T::Src;
+    using Dst = typename T::Dst;
+    using Event = typename T::Event;
+    using Mixin<Scan<T, S>>::operator=;
+
+    constexpr Scan() = default;
+    constexpr Scan(T parent, S scanner)
+        : parent_{std::move(parent)}
+        , scanner_{std::move(scanner)} {}
 
-    template <typename SId, typename EId>
-    bool operator()(SId sid, const EId& eid) {
-        if (!parent_(sid, eid)) {
+    template <typename SId, typename EId, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const EId& eid, Ctx&... ctx) {
+        if (!parent_.get()(sid, eid, ctx...) || S::isDelimiter(eid)) {
             return false;
         }
 
-        action_(sid, eid);
+        scanner_.get()(sid, Span<EId>{&eid, &eid + 1}, ctx...);
         return true;
     }
 
+    // Passes the longest prefix of [first, last) without delimiters to the scanner.
+    // Returns the end of the consumed prefix.
+    template <typename SId, typename EId, typename... Ctx>
+    const EId* scan(SId&& sid, const EId* first, const EId* last, Ctx&... ctx) {
+        const EId* end = S::find(first, last);
+        if (end != first) {
+            scanner_.get()(sid, Span<EId>{first, end}, ctx...);
+        }
+        return end;
+    }
+
  private:
-    T parent_;
-    A action_;
+    [[no_unique_address]] Slot<T, Scan> parent_;
+    [[no_unique_address]] Slot<S, Scan> scanner_;
 };
 
 template <typename T, typename C>
@@ -118,18 +204,19 @@ struct When : Mixin<When<T, C>> {
     using Event = typename T::Event;
     using Mixin<When<T, C>>::operator=;
 
-    When(T parent, C condition)
+    constexpr When() = default;
+    constexpr When(T parent, C condition)
         : parent_{std::move(parent)}
         , condition_{std::move(condition)} {}
 
-    template <typename SId, typename EId>
-    bool operator()(SId sid, const EId& eid) {
-        return parent_(sid, eid) && condition_(sid, eid);
+    template <typename SId, typename EId, typename... Ctx>
+    constexpr bool operator()(SId&& sid, const EId& eid, Ctx&... ctx) {
+        return parent_.get()(sid, eid, ctx...) && invoke(condition_.get(), sid, eid, ctx...);
     }
 
  private:
-    T parent_;
-    C condition_;
+    [[no_unique_address]] Slot<T, When> parent_;
+    [[no_unique_address]] Slot<C, When> condition_;
 };
 
 template <typename S, typename D, Event E>
@@ -139,8 +226,8 @@ struct Make : Mixin<Make<S, D, E>> {
     using Event = E;
     using Mixin<Make<S, D, E>>::operator=;
 
-    template <typename SId, typename EId>
-    bool operator()(SId, const EId&) {
+    template <typename SId, typename EId, typename... Ctx>
+    constexpr bool operator()(SId&&, const EId&, Ctx&...) {
         return true;
     }
 };
@@ -164,12 +251,12 @@ struct Src {
     using Tag = TTag;
 
     template <Event E>
-    auto on(E) const {
+    constexpr auto on(E) const {
         return transition::Make<Src, Dst<Tag, KeepStateId>, E>{};
     }
 
     template <Event E>
-    auto operator+(E event) const {
+    constexpr auto operator+(E event) const {
         return on(std::move(event));
     }
 
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace sml::impl::multistate {
+
+// Up to 16 states, each mapped to the state it has led to
+using Map = std::array<uint8_t, 16>;
+
+// Next state of each state for each byte value
+using Table = std::array<Map, 256>;
+
+inline constexpr size_t MaxStates = 16;
+
+inline constexpr Map Identity = [] {
+    Map map{};
+    for (uint8_t s = 0; s < map.size(); ++s) {
+        map[s] = s;
+    }
+    return map;
+}();
+
+// Advances all states at once: map[s] = table[e][map[s]] for each event e of [first, last)
+template <typename E>
+Map advanceScalar(const Table& table, Map map, const E* first, const E* last) {
+    for (; first != last; ++first) {
+        const Map& next = table[static_cast<uint8_t>(*first)];
+        for (auto& s : map) {
+            s = next[s];
+        }
+    }
+    return map;
+}
+
+// Maps each of states[first, last) through next, as one event broadcast to many instances.
+// States marked in slow are kept and passed to fallback(i) instead, which returns
+// whether instance i accepted the event. Returns the number of instances that did,
+// counting accepts for the mapped states.
+template <typename F>
+size_t broadcastScalar(
+    const Map& next,
+    const Map& slow,
+    const Map& accepts,
+    uint8_t* states,
+    size_t first,
+    size_t last,
+    F& fallback) {
+    size_t accepted = 0;
+    for (size_t i = first; i < last; ++i) {
+        uint8_t s = states[i];
+        if (slow[s]) {
+            accepted += fallback(i) ? 1 : 0;
+        } else {
+            accepted += accepts[s];
+            states[i] = next[s];
+        }
+    }
+    return accepted;
+}
+
+#if defined(__SSSE3__)
+
+// One byte shuffle per event
+inline constexpr bool Simd = true;
+
+template <typename E>
+Map advance(const Table& table, Map map, const E* first, const E* last) {
+    __m128i states = _mm_loadu_si128(reinterpret_cast<const __m128i*>(map.data()));
+    for (; first != last; ++first) {
+        const Map& next = table[static_cast<uint8_t>(*first)];
+        __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(next.data()));
+        states = _mm_shuffle_epi8(lut, states);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(map.data()), states);
+    return map;
+}
+
+// 16 instances per byte shuffle
+template <typename F>
+size_t broadcast(
+    const Map& next,
+    const Map& slow,
+    const Map& accepts,
+    uint8_t* states,
+    size_t n,
+    F&& fallback) {
+    __m128i next_lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(next.data()));
+    __m128i slow_lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slow.data()));
+    __m128i accepts_lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accepts.data()));
+    __m128i sums = _mm_setzero_si128();
+
+    size_t accepted = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto* block = reinterpret_cast<__m128i*>(states + i);
+        __m128i v = _mm_loadu_si128(block);
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_shuffle_epi8(slow_lut, v)));
+        sums = _mm_add_epi64(
+            sums,
+            _mm_sad_epu8(_mm_shuffle_epi8(accepts_lut, v), _mm_setzero_si128()));
+        _mm_storeu_si128(block, _mm_shuffle_epi8(next_lut, v));
+
+        for (; mask != 0; mask &= mask - 1) {
+            accepted += fallback(i + static_cast<size_t>(__builtin_ctz(mask))) ? 1 : 0;
+        }
+    }
+
+    accepted += static_cast<size_t>(_mm_cvtsi128_si64(sums)) +
+                static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)));
+    return accepted + broadcastScalar(next, slow, accepts, states, i, n, fallback);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+// One table lookup per event
+inline constexpr bool Simd = true;
+
+template <typename E>
+Map advance(const Table& table, Map map, const E* first, const E* last) {
+    uint8x16_t states = vld1q_u8(map.data());
+    for (; first != last; ++first) {
+        const Map& next = table[static_cast<uint8_t>(*first)];
+        states = vqtbl1q_u8(vld1q_u8(next.data()), states);
+    }
+    vst1q_u8(map.data(), states);
+    return map;
+}
+
+// 16 instances per table lookup
+template <typename F>
+size_t broadcast(
+    const Map& next,
+    const Map& slow,
+    const Map& accepts,
+    uint8_t* states,
+    size_t n,
+    F&& fallback) {
+    uint8x16_t next_lut = vld1q_u8(next.data());
+    uint8x16_t slow_lut = vld1q_u8(slow.data());
+    uint8x16_t accepts_lut = vld1q_u8(accepts.data());
+
+    size_t accepted = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(states + i);
+        uint8x16_t lanes = vqtbl1q_u8(slow_lut, v);
+        accepted += vaddlvq_u8(vqtbl1q_u8(accepts_lut, v));
+        vst1q_u8(states + i, vqtbl1q_u8(next_lut, v));
+
+        if (vmaxvq_u8(lanes) != 0) {
+            Map mask;
+            vst1q_u8(mask.data(), lanes);
+            for (size_t j = 0; j < mask.size(); ++j) {
+                accepted += mask[j] && fallback(i + j) ? 1 : 0;
+            }
+        }
+    }
+
+    return accepted + broadcastScalar(next, slow, accepts, states, i, n, fallback);
+}
+
+#else
+
+inline constexpr bool Simd = false;
+
+template <typename E>
+Map advance(const Table& table, Map map, const E* first, const E* last) {
+    return advanceScalar(table, map, first, last);
+}
+
+template <typename F>
+size_t broadcast(
+    const Map& next,
+    const Map& slow,
+    const Map& accepts,
+    uint8_t* states,
+    size_t n,
+    F&& fallback) {
+    return broadcastScalar(next, slow, accepts, states, 0, n, fallback);
+}
+
+#endif
+
+}  // namespace sml::impl::multistate
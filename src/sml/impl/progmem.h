@@ -0,0 +1,38 @@
+#pragma once
+
+#include <type_traits>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define SML_PROGMEM PROGMEM
+#else
+#define SML_PROGMEM
+#endif
+
+namespace sml::impl {
+
+// Reads an element of a constant table declared with SML_PROGMEM.
+// On AVR such tables live in flash and have to be read with pgm_read_*,
+// elsewhere they are plain .rodata. Constant evaluation reads them directly.
+template <typename T>
+constexpr T pgmRead(const T* ptr) {
+#if defined(__AVR__)
+    if (std::is_constant_evaluated()) {
+        return *ptr;
+    } else if constexpr (std::is_pointer_v<T>) {
+        return reinterpret_cast<T>(pgm_read_ptr(ptr));
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        return static_cast<T>(pgm_read_byte(ptr));
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 2) {
+        return static_cast<T>(pgm_read_word(ptr));
+    } else {
+        T value;
+        memcpy_P(&value, ptr, sizeof(T));
+        return value;
+    }
+#else
+    return *ptr;
+#endif
+}
+
+}  // namespace sml::impl
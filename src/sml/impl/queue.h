@@ -0,0 +1,234 @@
+#pragma once
+
+#include "sml/impl/progmem.h"
+#include "sml/impl/traits.h"
+
+#include <supp/type_list.h>
+
+#include <array>
+#include <new>
+#include <type_traits>
+
+#if __has_include(<atomic>)
+#include <atomic>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sml::impl::queue {
+
+// Position in the queue stored by one side and loaded by the other
+template <typename T>
+class Shared {
+ public:
+    // Happens after the loads and stores of the payload before it
+    void store(T value) {
+#if __has_include(<atomic>)
+        value_.store(value, std::memory_order_release);
+#else
+        __asm__ __volatile__("" ::: "memory");
+        value_ = value;
+#endif
+    }
+
+    // Happens before the loads and stores of the payload after it
+    T load() const {
+#if __has_include(<atomic>)
+        return value_.load(std::memory_order_acquire);
+#else
+        T value = value_;
+        __asm__ __volatile__("" ::: "memory");
+        return value;
+#endif
+    }
+
+ private:
+#if __has_include(<atomic>)
+    std::atomic<T> value_{0};
+#else
+    // Byte loads and stores are single instructions on AVR
+    static_assert(sizeof(T) == 1, "queues of more than 254 events need <atomic>");
+    volatile T value_ = 0;
+#endif
+};
+
+// Position in a queue used from one thread only
+template <typename T>
+class Local {
+ public:
+    constexpr void store(T value) {
+        value_ = value;
+    }
+
+    constexpr T load() const {
+        return value_;
+    }
+
+ private:
+    T value_ = 0;
+};
+
+// Storage of any of the events, aligned for all of them
+template <tl::IsList EIds>
+struct PayloadI;
+
+template <typename... EIds>
+struct PayloadI<tl::List<EIds...>> {
+    static constexpr size_t Align = [] {
+        size_t align = 1;
+        ((align = alignof(EIds) > align ? alignof(EIds) : align), ...);
+        return align;
+    }();
+
+    static constexpr size_t Size = [] {
+        size_t size = 0;
+        ((size = sizeof(EIds) > size ? sizeof(EIds) : size), ...);
+        return (size + Align - 1) / Align * Align;
+    }();
+};
+
+// Bounded FIFO of events of types EIds, each stored as the index of its type followed
+// by a copy of the event. Cursor is Shared for a producer and a consumer running
+// concurrently, Local otherwise.
+template <tl::IsList EIds, size_t Capacity, template <typename> typename Cursor>
+class Ring {
+    using TypeIndex = traits::StateIndex<EIds>;
+    using Payload = PayloadI<EIds>;
+
+    // One slot stays free to tell a full queue from an empty one
+    static constexpr size_t Slots = Capacity + 1;
+
+    using Pos = std::conditional_t<(Slots <= 255), uint8_t, size_t>;
+
+    static_assert(Capacity != 0);
+
+ public:
+    // Copies the event into the queue, returns false if the queue is full
+    template <typename EId>
+    bool push(const EId& event) {
+        static_assert(tl::Contains<EIds, EId>, "the machine has no such event");
+        static_assert(std::is_trivially_copyable_v<EId>, "queued events are copied bytewise");
+
+        Pos tail = tail_.load();
+        Pos after = next(tail);
+        if (after == head_.load()) {
+            return false;
+        }
+
+        types_[tail] = static_cast<TypeIndex>(tl::Find<EId, EIds>);
+        ::new (static_cast<void*>(payloads_[tail])) EId(event);
+        tail_.store(after);
+        return true;
+    }
+
+    // Calls f with the oldest event, then removes it. Returns false if the queue is empty.
+    // The event stays in its slot while f runs, f may push more events.
+    template <typename F>
+    bool pop(F& f) {
+        Pos head = head_.load();
+        if (head == tail_.load()) {
+            return false;
+        }
+
+        pgmRead(&Visitors<F, EIds>::value[types_[head]])(f, payloads_[head]);
+        head_.store(next(head));
+        return true;
+    }
+
+    // Removes the oldest event, then calls f with a copy of it. Returns false if the queue
+    // is empty. f may push the event back.
+    template <typename F>
+    bool take(F& f) {
+        Pos head = head_.load();
+        if (head == tail_.load()) {
+            return false;
+        }
+
+        pgmRead(&Takers<F, EIds>::value[types_[head]])(f, *this, head);
+        return true;
+    }
+
+    // Drops all the events, from the consumer side
+    void clear() {
+        head_.store(tail_.load());
+    }
+
+    size_t size() const {
+        Pos head = head_.load();
+        Pos tail = tail_.load();
+        return tail >= head ? tail - head : Slots - head + tail;
+    }
+
+    bool empty() const {
+        return head_.load() == tail_.load();
+    }
+
+ private:
+    static constexpr Pos next(Pos pos) {
+        return pos + 1 == Slots ? 0 : static_cast<Pos>(pos + 1);
+    }
+
+    template <typename F, typename EId>
+    static void visit(F& f, const std::byte* payload) {
+        f(*std::launder(reinterpret_cast<const EId*>(payload)));
+    }
+
+    template <typename F, typename EId>
+    static void takeOut(F& f, Ring& ring, Pos head) {
+        EId event = *std::launder(reinterpret_cast<const EId*>(ring.payloads_[head]));
+        ring.head_.store(next(head));
+        f(event);
+    }
+
+    // One visitor per event type, kept in flash on AVR
+    template <typename F, tl::IsList Ts>
+    struct Visitors;
+
+    template <typename F, typename... Ts>
+    struct Visitors<F, tl::List<Ts...>> {
+        static constexpr std::array<void (*)(F&, const std::byte*), sizeof...(Ts)> value
+            SML_PROGMEM = {
+                &visit<F, Ts>...,
+            };
+    };
+
+    template <typename F, tl::IsList Ts>
+    struct Takers;
+
+    template <typename F, typename... Ts>
+    struct Takers<F, tl::List<Ts...>> {
+        static constexpr std::array<void (*)(F&, Ring&, Pos), sizeof...(Ts)> value SML_PROGMEM = {
+            &takeOut<F, Ts>...,
+        };
+    };
+
+    Cursor<Pos> head_;
+    Cursor<Pos> tail_;
+    TypeIndex types_[Slots]{};
+    // Zeroed so that an empty queue is a constant, see SM::SM()
+    alignas(Payload::Align) std::byte payloads_[Slots][Payload::Size]{};
+};
+
+// Events raised by actions, passed to actions that take it after the machine context
+template <tl::IsList EIds, size_t Capacity>
+class Raised : Ring<EIds, Capacity, Local> {
+    using Base = Ring<EIds, Capacity, Local>;
+
+ public:
+    // Queues the event to be fed once the current event is processed,
+    // returns false if the queue is full
+    template <typename EId>
+    bool raise(const EId& event) {
+        return Base::push(event);
+    }
+
+    using Base::empty;
+    using Base::pop;
+};
+
+struct NoRaised {};
+
+struct NoDeferred {};
+
+}  // namespace sml::impl::queue
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "sml/impl/invoke.h"
+#include "sml/span.h"
+
+#include <type_traits>
+#include <utility>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace sml::impl::scan {
+
+template <typename E>
+constexpr bool IsByte = std::is_integral_v<E> && sizeof(E) == 1;
+
+// Returns the first element of [first, last) equal to one of Ds, or last
+template <auto... Ds, typename E>
+const E* findAnyScalar(const E* first, const E* last) {
+    for (; first != last; ++first) {
+        if (((*first == Ds) || ...)) {
+            break;
+        }
+    }
+    return first;
+}
+
+#if defined(__SSE2__)
+
+template <auto... Ds, typename E>
+const E* findAnySimd(const E* first, const E* last) {
+    for (; last - first >= 16; first += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        __m128i eq = (_mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(Ds))) | ...);
+        if (int mask = _mm_movemask_epi8(eq)) {
+            return first + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+    return findAnyScalar<Ds...>(first, last);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+template <auto... Ds, typename E>
+const E* findAnySimd(const E* first, const E* last) {
+    for (; last - first >= 16; first += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(first));
+        uint8x16_t eq = (vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(Ds))) | ...);
+        // 4 bits per byte of eq
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask != 0) {
+            return first + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return findAnyScalar<Ds...>(first, last);
+}
+
+#else
+
+template <auto... Ds, typename E>
+const E* findAnySimd(const E* first, const E* last) {
+    return findAnyScalar<Ds...>(first, last);
+}
+
+#endif
+
+template <auto D, decltype(D)... Ds, typename E>
+const E* findAny(const E* first, const E* last) {
+    if constexpr (IsByte<E> && sizeof...(Ds) == 0) {
+        auto size = static_cast<size_t>(last - first);
+        auto found = memchr(first, static_cast<unsigned char>(D), size);
+        return found ? static_cast<const E*>(found) : last;
+    } else if constexpr (IsByte<E>) {
+        return findAnySimd<D, Ds...>(first, last);
+    } else {
+        return findAnyScalar<D, Ds...>(first, last);
+    }
+}
+
+// Action applied to runs of events up to (not including) one of the delimiters Ds
+template <typename A, auto D, decltype(D)... Ds>
+struct Until {
+    using Event = decltype(D);
+
+    static constexpr bool isDelimiter(const Event& e) {
+        return e == D || ((e == Ds) || ...);
+    }
+
+    static const Event* find(const Event* first, const Event* last) {
+        return findAny<D, Ds...>(first, last);
+    }
+
+    template <typename SId, typename... Ctx>
+    constexpr void operator()(SId&& sid, Span<Event> run, Ctx&... ctx) {
+        invoke(action, sid, run, ctx...);
+    }
+
+    [[no_unique_address]] A action;
+};
+
+template <typename T>
+struct IsUntilI : std::false_type {};
+
+template <typename A, auto D, decltype(D)... Ds>
+struct IsUntilI<Until<A, D, Ds...>> : std::true_type {};
+
+template <typename T>
+concept IsUntil = IsUntilI<T>::value;
+
+}  // namespace sml::impl::scan
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+#include <stddef.h>
+
+namespace sml::impl {
+
+// Transitions of a machine laid out flat as its bases, each at most once: empty ones take
+// no space. Unlike std::tuple, trivially copyable when all of them are, so that machines
+// can be copied with memcpy and relocated by containers.
+template <typename... Ts>
+struct Storage : Ts... {
+    constexpr explicit Storage(std::tuple<Ts...> ts)
+        : Storage{std::move(ts), std::index_sequence_for<Ts...>{}} {}
+
+ private:
+    template <size_t... Is>
+    constexpr Storage([[maybe_unused]] std::tuple<Ts...>&& ts, std::index_sequence<Is...>)
+        : Ts{std::move(std::get<Is>(ts))}... {}
+};
+
+template <typename... Ts>
+Storage(std::tuple<Ts...>) -> Storage<Ts...>;
+
+template <typename T, typename... Ts>
+constexpr T& get(Storage<Ts...>& storage) {
+    return static_cast<T&>(storage);
+}
+
+}  // namespace sml::impl
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "sml/ids.h"
+#include "sml/impl/guard.h"
 #include "sml/impl/make.h"
+#include "sml/impl/progmem.h"
+#include "sml/impl/storage.h"
 
-#include <supp/tuple.h>
 #include <supp/type_list.h>
 
+#include <array>
+#include <concepts>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <stdint.h>
+
 namespace sml::impl::traits {
 
 template <StateMachine M>
@@ -76,11 +87,14 @@ class CombinedStateMachine {
     using InitialId = typename M::InitialId;
 
     template <StateMachine... Machines>
-    explicit CombinedStateMachine(Machines... machines) : machines_{std::move(machines)...} {}
-
-    sml::TransitionsTuple auto transitions() {
-        return supp::tuple_convert<TransitionsTuple>(
-            std::apply([](auto&... m) { return std::tuple_cat(m.transitions()...); }, machines_));
+    constexpr explicit CombinedStateMachine(Machines... machines)
+        : machines_{keep(MachinesTuple{std::move(machines)...}, Kept{})} {}
+
+    constexpr sml::TransitionsTuple auto transitions() {
+        auto all = [this]<typename... Ms>(tl::List<Ms...>) {
+            return std::tuple_cat(transitionsOf<Ms>()...);
+        }(Machines{});
+        return tag(std::move(all), std::make_index_sequence<std::tuple_size_v<decltype(all)>>{});
     }
 
  private:
@@ -90,7 +104,40 @@ class CombinedStateMachine {
     using MachinesTuple = tl::ApplyToTemplate<Machines, std::tuple>;
     using TransitionsTuple = tl::ApplyToTemplate<Transitions, std::tuple>;
 
-    MachinesTuple machines_;
+    // Wraps each transition into its Tagged counterpart
+    template <typename Tuple, size_t... Is>
+    static constexpr TransitionsTuple tag([[maybe_unused]] Tuple all, std::index_sequence<Is...>) {
+        return TransitionsTuple{
+            std::tuple_element_t<Is, TransitionsTuple>{std::move(std::get<Is>(all))}...,
+        };
+    }
+
+    // Machines with data are kept for the transitions to refer to, empty ones are made on use
+    struct KeptPred {
+        template <typename T>
+        static constexpr bool test() {
+            return !std::is_empty_v<T>;
+        }
+    };
+
+    using Kept = tl::Filter<KeptPred, Machines>;
+
+    template <typename... Ks>
+    static constexpr std::tuple<Ks...> keep([[maybe_unused]] MachinesTuple all, tl::List<Ks...>) {
+        return std::tuple<Ks...>{std::move(std::get<Ks>(all))...};
+    }
+
+    template <typename T>
+    constexpr auto transitionsOf() {
+        if constexpr (std::is_empty_v<T>) {
+            return T{}.transitions();
+        } else {
+            return impl::get<T>(machines_).transitions();
+        }
+    }
+
+    // Trivially copyable when the kept machines are
+    [[no_unique_address]] tl::ApplyToTemplate<Kept, Storage> machines_;
 };
 
 // Filters transitions by event Id
@@ -166,6 +213,27 @@ struct GetStateSpecsI {
 template <tl::IsList Transitions>
 using GetStateSpecs = typename GetStateSpecsI<Transitions>::type;
 
+// Narrowest unsigned type able to index StateSpecs and to hold NoState and NoState - 1
+template <tl::IsList StateSpecs>
+using StateIndex = std::conditional_t<(tl::Size<StateSpecs> < 255), uint8_t, uint16_t>;
+
+template <typename Index>
+inline constexpr Index NoState = static_cast<Index>(~Index{0});
+
+// Maps each spec index in From to its index in To (or NoState if absent)
+template <typename Index, tl::IsList From, tl::IsList To>
+struct InjectionI;
+
+template <typename Index, typename... From, tl::IsList To>
+struct InjectionI<Index, tl::List<From...>, To> {
+    static constexpr std::array<Index, sizeof...(From)> value SML_PROGMEM = {
+        (tl::Contains<To, From> ? static_cast<Index>(tl::Find<From, To>) : NoState<Index>)...,
+    };
+};
+
+template <typename Index, tl::IsList From, tl::IsList To>
+inline constexpr auto& Injection = InjectionI<Index, From, To>::value;
+
 template <tl::IsList Transitions, tl::IsList AllStateSpecs>
 struct GetSrcSpecsI {
     struct Mapper {
@@ -208,6 +276,23 @@ struct GetEventIdsI {
 template <tl::IsList Transitions>
 using GetEventIds = typename GetEventIdsI<Transitions>::type;
 
+// Transitions leading to defer, or all the others
+template <tl::IsList Transitions, bool Defer = true>
+struct FilterDeferringI {
+    struct Pred {
+        template <Transition T>
+        static constexpr bool test() {
+            return std::same_as<DeferStateId, typename T::Dst::Id> == Defer;
+        }
+    };
+
+    using type = tl::Filter<Pred, Transitions>;
+};
+
+// Event ids the transitions may defer
+template <tl::IsList Transitions>
+using GetDeferredEventIds = GetEventIds<typename FilterDeferringI<Transitions>::type>;
+
 // event ids of all transitions with matching source state tag
 template <typename Tag, tl::IsList Transitions>
 struct GetEventIdsBySrcTagI {
@@ -254,4 +339,394 @@ template <typename SrcSpec, typename EId, tl::IsList Transitions>
 using FilterTransitionsBySrcAndEvent =
     typename FilterTransitionsBySrcAndEventI<SrcSpec, EId, Transitions>::type;
 
+// Guard-free scan transitions (the source state is kept)
+template <Transition T>
+struct IsScanTransitionI : std::false_type {};
+
+template <typename S, typename D, Event E, typename Scanner>
+struct IsScanTransitionI<transition::Scan<transition::Make<S, D, E>, Scanner>> : std::true_type {};
+
+template <Transition T, typename Tag>
+struct IsScanTransitionI<transition::Tagged<T, Tag>> : IsScanTransitionI<T> {};
+
+template <typename T>
+concept ScanTransition = IsScanTransitionI<T>::value;
+
+// Source states whose first transition on EId is a scan transition
+template <typename EId, tl::IsList Transitions, tl::IsList SrcSpecs>
+struct GetScanSrcSpecsI {
+    struct Pred {
+        template <typename SrcSpec>
+        static constexpr bool test() {
+            using Ts = FilterTransitionsBySrcAndEvent<SrcSpec, EId, Transitions>;
+            if constexpr (tl::Empty<Ts>) {
+                return false;
+            } else {
+                return ScanTransition<tl::At<0, Ts>>;
+            }
+        }
+    };
+
+    using type = tl::Filter<Pred, SrcSpecs>;
+};
+
+template <typename EId, tl::IsList Transitions, tl::IsList SrcSpecs>
+using GetScanSrcSpecs = typename GetScanSrcSpecsI<EId, Transitions, SrcSpecs>::type;
+
+// Byte values an event must have for transition T to accept it.
+// Only value guards checked before any other guard or action narrow the set:
+// skipping T for the other values must not skip side effects.
+template <Transition T>
+struct ValueGuardI {
+    static constexpr guard::ByteSet Values = guard::ByteSet::all();
+    static constexpr bool Pure = false;
+};
+
+template <typename S, typename D, Event E>
+struct ValueGuardI<transition::Make<S, D, E>> {
+    static constexpr guard::ByteSet Values = guard::ByteSet::all();
+    static constexpr bool Pure = true;
+};
+
+template <typename T, typename D>
+struct ValueGuardI<transition::To<T, D>> : ValueGuardI<T> {};
+
+template <Transition T, typename Tag>
+struct ValueGuardI<transition::Tagged<T, Tag>> : ValueGuardI<T> {};
+
+template <typename T, typename C>
+struct ValueGuardI<transition::When<T, C>> {
+    static constexpr bool Pure = ValueGuardI<T>::Pure && guard::ValuesI<C>::Pure;
+    static constexpr guard::ByteSet Values = ValueGuardI<T>::Pure
+        ? ValueGuardI<T>::Values & guard::ValuesI<C>::Values
+        : ValueGuardI<T>::Values;
+};
+
+template <typename T, typename A>
+struct ValueGuardI<transition::Run<T, A>> {
+    static constexpr guard::ByteSet Values = ValueGuardI<T>::Values;
+    static constexpr bool Pure = false;
+};
+
+template <typename T, typename S>
+struct ValueGuardI<transition::Scan<T, S>> {
+    static constexpr guard::ByteSet Values = ValueGuardI<T>::Values;
+    static constexpr bool Pure = false;
+};
+
+template <Transition T>
+constexpr guard::ByteSet ValueGuard = ValueGuardI<T>::Values;
+
+template <typename T>
+concept ValueGuarded = ValueGuard<T> != guard::ByteSet::all();
+
+template <tl::IsList Transitions>
+struct CountValueGuardedI {
+    struct Pred {
+        template <Transition T>
+        static constexpr bool test() {
+            return ValueGuarded<T>;
+        }
+    };
+
+    static constexpr size_t value = tl::Size<tl::Filter<Pred, Transitions>>;
+};
+
+template <tl::IsList Transitions>
+inline constexpr size_t CountValueGuarded = CountValueGuardedI<Transitions>::value;
+
+// Maps each byte value to the index of the first transition that may accept it
+// (or the number of transitions if none may)
+template <tl::IsList Transitions>
+struct FirstCandidateI;
+
+template <typename... Ts>
+struct FirstCandidateI<tl::List<Ts...>> {
+    static_assert(sizeof...(Ts) < 256);
+
+    static constexpr std::array<uint8_t, 256> value SML_PROGMEM = [] {
+        constexpr std::array<guard::ByteSet, sizeof...(Ts)> values{ValueGuard<Ts>...};
+
+        std::array<uint8_t, 256> first{};
+        for (unsigned b = 0; b < first.size(); ++b) {
+            uint8_t i = 0;
+            while (i < values.size() && !values[i].contains(b)) {
+                ++i;
+            }
+            first[b] = i;
+        }
+        return first;
+    }();
+};
+
+template <tl::IsList Transitions>
+inline constexpr auto& FirstCandidate = FirstCandidateI<Transitions>::value;
+
+// Whether transition T accepts exactly the byte values in Values: all of its guards
+// are value guards checked before any of its actions (Acts).
+// Such transitions can be compiled into a table of next states.
+template <Transition T>
+struct CompiledI {
+    static constexpr guard::ByteSet Values = guard::ByteSet::all();
+    static constexpr bool Exact = false;
+    static constexpr bool Acts = true;
+};
+
+template <typename S, typename D, Event E>
+struct CompiledI<transition::Make<S, D, E>> {
+    static constexpr guard::ByteSet Values = guard::ByteSet::all();
+    static constexpr bool Exact = true;
+    static constexpr bool Acts = false;
+};
+
+// Deferring keeps the event, which a table of next states cannot express
+template <typename T, typename D>
+struct CompiledI<transition::To<T, D>> : CompiledI<T> {
+    static constexpr bool Exact =
+        CompiledI<T>::Exact && !std::same_as<DeferStateId, typename D::Id>;
+};
+
+template <Transition T, typename Tag>
+struct CompiledI<transition::Tagged<T, Tag>> : CompiledI<T> {};
+
+template <typename T, typename C>
+struct CompiledI<transition::When<T, C>> {
+    static constexpr guard::ByteSet Values = CompiledI<T>::Values & guard::ValuesI<C>::Values;
+    static constexpr bool Exact =
+        CompiledI<T>::Exact && !CompiledI<T>::Acts && guard::ValuesI<C>::Pure;
+    static constexpr bool Acts = CompiledI<T>::Acts;
+};
+
+template <typename T, typename A>
+struct CompiledI<transition::Run<T, A>> {
+    static constexpr guard::ByteSet Values = CompiledI<T>::Values;
+    static constexpr bool Exact = CompiledI<T>::Exact;
+    static constexpr bool Acts = true;
+};
+
+template <typename T, typename A, auto D, decltype(D)... Ds>
+struct CompiledI<transition::Scan<T, scan::Until<A, D, Ds...>>> {
+    static constexpr guard::ByteSet Values =
+        CompiledI<T>::Values & ~guard::ByteSet::of(D, Ds...);
+    static constexpr bool Exact = CompiledI<T>::Exact && !CompiledI<T>::Acts;
+    static constexpr bool Acts = true;
+};
+
+template <tl::IsList Transitions>
+struct AllCompiledI;
+
+template <typename... Ts>
+struct AllCompiledI<tl::List<Ts...>> {
+    static constexpr bool value = (CompiledI<Ts>::Exact && ...);
+};
+
+// Whether all of the Transitions can be compiled into a table
+template <tl::IsList Transitions>
+inline constexpr bool AllCompiled = AllCompiledI<Transitions>::value;
+
+// State the machine moves on to right after entering state Spec, as the first onEnter
+// transition taken leads: Spec itself if none leads elsewhere, NoState if that depends
+// on a guard
+template <typename Spec, tl::IsList Transitions>
+inline constexpr auto EnterDst = [] {
+    using StateSpecs = GetStateSpecs<Transitions>;
+    using Index = StateIndex<StateSpecs>;
+    using Ts = FilterTransitionsBySrcAndEvent<
+        Spec,
+        OnEnterEventId,
+        FilterTransitionsByEventId<OnEnterEventId, Transitions>>;
+    constexpr auto Self = static_cast<Index>(tl::Find<Spec, StateSpecs>);
+
+    Index dst = Self;
+    bool guarded = false;
+    auto matcher = [&]<Transition T>(tl::Type<T>) {
+        using DstId = typename T::Dst::Id;
+        using C = CompiledI<T>;
+        bool unguarded = C::Exact && C::Values == guard::ByteSet::all();
+
+        if constexpr (std::same_as<BypassStateId, DstId>) {
+            return false;
+        } else if constexpr (std::same_as<KeepStateId, DstId>) {
+            guarded = guarded || !unguarded;
+            return unguarded;
+        } else {
+            using DstSpec = StateSpec<DstId, typename T::Dst::Tag>;
+            dst = unguarded && !guarded ? static_cast<Index>(tl::Find<DstSpec, StateSpecs>)
+                                        : NoState<Index>;
+            return true;
+        }
+    };
+
+    tl::forEachShortCircuit(matcher, Ts{});
+    return dst;
+}();
+
+// Chains of onEnter transitions leading to other states, which the SM follows one
+// after another when it changes state
+template <tl::IsList Transitions, tl::IsList Specs = GetStateSpecs<Transitions>>
+struct EnterChainsI;
+
+template <tl::IsList Transitions, typename... Specs>
+struct EnterChainsI<Transitions, tl::List<Specs...>> {
+ private:
+    using StateSpecs = tl::List<Specs...>;
+    using Index = StateIndex<StateSpecs>;
+
+    static constexpr size_t N = sizeof...(Specs);
+
+    // States the onEnter transitions of Spec may lead to, guarded or not
+    template <typename Spec>
+    static constexpr std::array<bool, N> targets() {
+        using Ts = FilterTransitionsBySrcAndEvent<
+            Spec,
+            OnEnterEventId,
+            FilterTransitionsByEventId<OnEnterEventId, Transitions>>;
+        constexpr size_t Self = tl::Find<Spec, StateSpecs>;
+
+        std::array<bool, N> to{};
+        auto add = [&]<Transition T>(tl::Type<T>) {
+            using DstId = typename T::Dst::Id;
+            if constexpr (!tl::Contains<EphemeralStateIds, DstId>) {
+                using DstSpec = StateSpec<DstId, typename T::Dst::Tag>;
+                constexpr size_t Target = tl::Find<DstSpec, StateSpecs>;
+                to[Target] = to[Target] || Target != Self;
+            }
+            return false;
+        };
+        tl::forEachShortCircuit(add, Ts{});
+        return to;
+    }
+
+    static constexpr std::array<std::array<bool, N>, N> Edges{targets<Specs>()...};
+    static constexpr std::array<Index, N> Dsts{EnterDst<Specs, Transitions>...};
+
+ public:
+    static constexpr size_t NoBound = ~size_t{0};
+
+    // Whether unguarded onEnter transitions lead around in a cycle, never settling
+    static constexpr bool Cycles = [] {
+        for (size_t i = 0; i < N; ++i) {
+            size_t state = i;
+            for (size_t step = 0; Dsts[state] != NoState<Index> && Dsts[state] != state; ++step) {
+                if (step == N) {
+                    return true;
+                }
+                state = Dsts[state];
+            }
+        }
+        return false;
+    }();
+
+    // Most onEnter transitions taken one after another on a state change,
+    // NoBound if they may lead around in a cycle
+    static constexpr size_t Longest = [] {
+        std::array<size_t, N> depth{};
+        for (size_t round = 0; round <= N; ++round) {
+            bool changed = false;
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = 0; j < N; ++j) {
+                    if (Edges[i][j] && depth[i] < depth[j] + 1) {
+                        depth[i] = depth[j] + 1;
+                        changed = true;
+                    }
+                }
+            }
+            if (!changed) {
+                size_t longest = 0;
+                for (size_t d : depth) {
+                    longest = d > longest ? d : longest;
+                }
+                return longest;
+            }
+        }
+        return NoBound;
+    }();
+};
+
+template <tl::IsList Transitions>
+using EnterChains = EnterChainsI<Transitions>;
+
+// Whether entering state Spec only passes on to another state: its first onEnter
+// transition is unguarded, runs no actions and leads elsewhere, and it has no onExit
+// transitions and no local data. Transitions into it may lead straight on.
+template <typename Spec, tl::IsList Transitions>
+inline constexpr bool PassThrough = [] {
+    using Enters = FilterTransitionsBySrcAndEvent<
+        Spec,
+        OnEnterEventId,
+        FilterTransitionsByEventId<OnEnterEventId, Transitions>>;
+    using Exits = FilterTransitionsBySrcAndEvent<
+        Spec,
+        OnExitEventId,
+        FilterTransitionsByEventId<OnExitEventId, Transitions>>;
+    constexpr bool Local = std::derived_from<typename Spec::Id, sml::Local> ||
+                           std::derived_from<typename Spec::Tag, sml::Local>;
+
+    if constexpr (tl::Empty<Enters> || !tl::Empty<Exits> || Local) {
+        return false;
+    } else {
+        using C = CompiledI<tl::At<0, Enters>>;
+        using DstId = typename tl::At<0, Enters>::Dst::Id;
+        return C::Exact && !C::Acts && C::Values == guard::ByteSet::all() &&
+               !tl::Contains<EphemeralStateIds, DstId> &&
+               EnterDst<Spec, Transitions> != tl::Find<Spec, GetStateSpecs<Transitions>>;
+    }
+}();
+
+// State each state settles in once entered, past the pass-through states on the way
+template <tl::IsList Transitions, tl::IsList Specs = GetStateSpecs<Transitions>>
+struct SettleI;
+
+template <tl::IsList Transitions, typename... Specs>
+struct SettleI<Transitions, tl::List<Specs...>> {
+    using Index = StateIndex<tl::List<Specs...>>;
+
+    static constexpr size_t N = sizeof...(Specs);
+
+    static constexpr std::array<Index, N> value = [] {
+        constexpr std::array<bool, N> pass{PassThrough<Specs, Transitions>...};
+        constexpr std::array<Index, N> dsts{EnterDst<Specs, Transitions>...};
+
+        std::array<Index, N> settle{};
+        for (size_t i = 0; i < N; ++i) {
+            size_t state = i;
+            for (size_t step = 0; step < N && pass[state]; ++step) {
+                state = dsts[state];
+            }
+            settle[i] = static_cast<Index>(state);
+        }
+        return settle;
+    }();
+};
+
+template <tl::IsList Transitions>
+inline constexpr auto& Settle = SettleI<Transitions>::value;
+
+// Whether each state has transitions other than defer ones on the deferred events.
+// Deferred events fed again in the other states would only stay deferred.
+template <tl::IsList Transitions, tl::IsList Specs = GetStateSpecs<Transitions>>
+struct AcceptsDeferredI;
+
+template <tl::IsList Transitions, typename... Specs>
+struct AcceptsDeferredI<Transitions, tl::List<Specs...>> {
+    using Others = typename FilterDeferringI<Transitions, false>::type;
+
+    template <typename Spec, typename... EIds>
+    static constexpr bool acceptsAny(tl::List<EIds...>) {
+        return (
+            !tl::Empty<FilterTransitionsBySrcAndEvent<
+                Spec,
+                EIds,
+                FilterTransitionsByEventId<EIds, Others>>> ||
+            ...);
+    }
+
+    static constexpr std::array<bool, sizeof...(Specs)> value SML_PROGMEM = {
+        acceptsAny<Specs>(GetDeferredEventIds<Transitions>{})...,
+    };
+};
+
+template <tl::IsList Transitions>
+inline constexpr auto& AcceptsDeferred = AcceptsDeferredI<Transitions>::value;
+
 }  // namespace sml::impl::traits
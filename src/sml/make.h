@@ -1,6 +1,7 @@
 #pragma once
 
 #include "sml/ids.h"
+#include "sml/impl/guard.h"
 #include "sml/impl/make.h"
 
 namespace sml {
@@ -14,6 +15,10 @@ constexpr DstState auto dst = impl::state::Dst<void, Id>{};
 inline constexpr DstState auto bypass = dst<BypassStateId>;
 inline constexpr DstState auto x = dst<TerminalStateId>;
 
+// Keeps the event in the buffer of deferred events of the SM, to be fed again once
+// the state changes, see SM. The root machine sets the capacity of the buffer.
+inline constexpr DstState auto defer = dst<DeferStateId>;
+
 template <StateMachine M>
 constexpr DstState auto enter = impl::state::Dst<M, typename M::InitialId>{};
 
@@ -26,8 +31,29 @@ constexpr Event auto ev = impl::event::Make<Id...>{};
 inline constexpr Event auto onEnter = ev<OnEnterEventId>;
 inline constexpr Event auto onExit = ev<OnExitEventId>;
 
+// Action run on events up to (not including) one of the delimiters D, Ds...
+// Called with Span<decltype(D)> runs: a whole run at once when the machine
+// is fed a contiguous range, a single-element run otherwise.
+template <auto D, decltype(D)... Ds, typename A>
+constexpr auto until(A action) {
+    return impl::scan::Until<A, D, Ds...>{std::move(action)};
+}
+
+// Guards on byte event values. Known at compile time, so that a state with several
+// of them finds the matching transition with a single table lookup.
+template <auto C, decltype(C)... Cs>
+constexpr auto eq = impl::guard::In<impl::guard::ByteSet::of(C, Cs...)>{};
+
+template <auto Lo, decltype(Lo) Hi>
+constexpr auto in_range = impl::guard::In<impl::guard::ByteSet::range(
+    static_cast<uint8_t>(Lo),
+    static_cast<uint8_t>(Hi))>{};
+
+template <impl::guard::Chars S>
+constexpr auto one_of = impl::guard::In<S.set()>{};
+
 template <Transition... Ts>
-TransitionsTuple auto table(Ts... ts) {
+constexpr TransitionsTuple auto table(Ts... ts) {
     return std::tuple<Ts...>(std::move(ts)...);
 }
 
@@ -0,0 +1,382 @@
+#pragma once
+
+// Native only: needs threads
+
+#include "sml/impl/multistate.h"
+#include "sml/impl/traits.h"
+#include "sml/sm.h"
+
+#include <supp/type_list.h>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sml {
+
+namespace impl {
+
+// Threads kept across calls of feedParallel(), started as calls need more of them.
+// Calls from several threads take turns.
+class Workers {
+ public:
+    static Workers& get() {
+        static Workers workers;
+        return workers;
+    }
+
+    Workers(const Workers&) = delete;
+
+    ~Workers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Runs f(k) for each k in [0, n): f(0) in the calling thread, the others in workers.
+    // Returns once all of them are done. Nested calls from f run serially in their thread,
+    // since the workers are busy with the outer call.
+    template <typename F>
+    void run(size_t n, F&& f) {
+        if (running_) {
+            for (size_t k = 0; k < n; ++k) {
+                f(k);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> turn(turn_);
+        while (threads_.size() + 1 < n) {
+            // Starts waiting for the next round, round_ only changes during turns
+            threads_.emplace_back([this, k = threads_.size() + 1, seen = round_] {
+                loop(k, seen);
+            });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = [](void* f, size_t k) { (*static_cast<std::remove_reference_t<F>*>(f))(k); };
+            f_ = &f;
+            count_ = n;
+            pending_ = n - 1;
+            ++round_;
+        }
+        wake_.notify_all();
+
+        running_ = true;
+        f(0);
+        running_ = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+ private:
+    Workers() = default;
+
+    void loop(size_t k, size_t seen) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&] { return stop_ || round_ != seen; });
+            if (stop_) {
+                return;
+            }
+
+            seen = round_;
+            if (k < count_) {
+                auto task = task_;
+                void* f = f_;
+                lock.unlock();
+                running_ = true;
+                task(f, k);
+                running_ = false;
+                lock.lock();
+                if (--pending_ == 0) {
+                    done_.notify_one();
+                }
+            }
+        }
+    }
+
+    // Whether this thread runs a task of a call
+    static inline thread_local bool running_ = false;
+
+    std::mutex turn_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<std::thread> threads_;
+    void (*task_)(void*, size_t) = nullptr;
+    void* f_ = nullptr;
+    size_t count_ = 0;
+    size_t pending_ = 0;
+    size_t round_ = 0;
+    bool stop_ = false;
+};
+
+// Speculative chunked simulation of the compiled table, see sml::feedParallel()
+template <StateMachine TM, typename Policy, typename Ctx>
+class Parallel<SM<TM, Policy, Ctx>> {
+    using Machine = SM<TM, Policy, Ctx>;
+    using Trs = typename Machine::Trs;
+    using StateSpecs = typename Machine::StateSpecs;
+    using Index = typename Machine::StateIndex;
+
+    static constexpr size_t N = tl::Size<StateSpecs>;
+    static constexpr Index Rejected = traits::NoState<Index>;
+    static constexpr Index Terminal = Machine::TerminalIdx;
+
+    // State the machine ends up in after an onEnter in Spec, as transit() follows it.
+    // Unknown if that depends on a guard.
+    static constexpr Index Unknown = Rejected;
+
+    template <typename Spec>
+    static constexpr Index EnterDst = traits::EnterDst<Spec, Trs>;
+
+    template <tl::IsList Specs>
+    struct SettledI;
+
+    template <typename... Specs>
+    struct SettledI<tl::List<Specs...>> {
+        static constexpr std::array<Index, N> value = [] {
+            constexpr std::array<Index, N> enter_dst{EnterDst<Specs>...};
+
+            std::array<Index, N> settled{};
+            for (size_t i = 0; i < N; ++i) {
+                Index state = static_cast<Index>(i);
+                for (size_t step = 0; step < N && state != Unknown; ++step) {
+                    if (enter_dst[state] == state) {
+                        break;
+                    }
+                    state = enter_dst[state];
+                }
+                settled[i] = state;
+            }
+            return settled;
+        }();
+    };
+
+    // State each state settles in once entered
+    static constexpr auto& Settled = SettledI<StateSpecs>::value;
+
+ public:
+    // Whether chunks are walked from all states at once with a byte shuffle.
+    // Needs a spare state standing for stopped walks.
+    static constexpr bool Shuffled = multistate::Simd && N < multistate::MaxStates;
+
+    static constexpr Index Stopped = static_cast<Index>(N);
+
+    // Next state of each state for each byte: rejected events lead to Stopped,
+    // the terminal state is kept
+    template <typename E>
+    static constexpr multistate::Table ShuffleTable = [] {
+        using Disp = Dispatcher<E, Trs>;
+
+        multistate::Table table{};
+        for (unsigned b = 0; b < table.size(); ++b) {
+            for (size_t s = 0; s < multistate::MaxStates; ++s) {
+                auto state = static_cast<Index>(s);
+                Index next = Stopped;
+                if (s < N && state == Terminal) {
+                    next = state;
+                } else if (s < N) {
+                    Index dst = Disp::template compiledNext<Policy>(state, static_cast<uint8_t>(b));
+                    next = dst == Rejected ? Stopped : dst == state ? state : Settled[dst];
+                }
+                table[b][s] = static_cast<uint8_t>(next);
+            }
+        }
+        return table;
+    }();
+
+    // States change in the simulation without feeding deferred events again
+    static constexpr bool Defers = Machine::CanDefer;
+
+    // The simulation follows the compiled table only, not the raised events
+    static constexpr bool Raises = Machine::CanRaise;
+
+    static constexpr bool Supported = [] {
+        for (Index s : Settled) {
+            if (s == Unknown) {
+                return false;
+            }
+        }
+        return true;
+    }();
+
+    template <typename E>
+    static size_t feed(Machine& sm, const E* first, const E* last, size_t threads) {
+        using Disp = Dispatcher<E, Trs>;
+        static_assert(Disp::Compiled, "feedParallel() needs a compiled byte event");
+
+        auto size = static_cast<size_t>(last - first);
+        size_t chunks = std::max<size_t>(1, std::min(threads, size));
+        auto chunk = [&](size_t k) { return first + size * k / chunks; };
+
+        // State each state leads to over each chunk but the first, whose start is known
+        std::vector<std::array<Index, N>> maps(chunks);
+        End<E> head;
+        parallelFor(chunks, [&](size_t k) {
+            const E* begin = chunk(k);
+            const E* end = chunk(k + 1);
+            if (k == 0) {
+                head = walk<Disp>(sm.state_idx_, begin, end, nullptr, nullptr);
+            } else {
+                maps[k] = advance<Disp>(begin, end);
+            }
+        });
+
+        // Start state of every chunk and the event feeding stops at, if any.
+        // The chunk it stops in is walked again from its start to find the event.
+        std::vector<Index> starts(chunks);
+        starts[0] = sm.state_idx_;
+        End<E> tail = head;
+        size_t stopped = 1;
+        for (; stopped < chunks && !tail.stop; ++stopped) {
+            Index start = tail.state;
+            Index end = maps[stopped][start];
+            starts[stopped] = start;
+            tail = end == Rejected || end == Terminal
+                ? walk<Disp>(start, chunk(stopped), chunk(stopped + 1), nullptr, nullptr)
+                : End<E>{end, nullptr};
+        }
+        chunks = stopped;
+        size_t consumed = tail.stop ? static_cast<size_t>(tail.stop - first) : size;
+
+        // Events that run actions or change the state, the others are self loops
+        std::vector<std::vector<const E*>> events(chunks);
+        parallelFor(chunks, [&](size_t k) {
+            const E* end = std::min(chunk(k + 1), first + consumed);
+            Index state = starts[k];
+            for (const E* it = chunk(k); it != end; ++it) {
+                auto step = Disp::template lookup<Policy>(state, *it);
+                if (step.acts || step.dst != state) {
+                    events[k].push_back(it);
+                }
+                state = step.dst == state ? state : Settled[step.dst];
+            }
+        });
+
+        // Replay them in order, the state between them does not change
+        for (const auto& chunk_events : events) {
+            for (const E* it : chunk_events) {
+                sm.feedAll(it, it + 1);
+            }
+        }
+
+        return consumed;
+    }
+
+ private:
+    template <typename E>
+    struct End {
+        Index state = 0;
+        const E* stop = nullptr;  // rejected event or the event the terminal state is reached at
+    };
+
+    // Runs the table from every state over [first, last) without actions.
+    // Rejected for the states feeding stops in before the end.
+    template <typename Disp, typename E>
+    static std::array<Index, N> advance(const E* first, const E* last) {
+        std::array<Index, N> map{};
+        if constexpr (Shuffled) {
+            auto states = multistate::advance(ShuffleTable<E>, multistate::Identity, first, last);
+            for (size_t s = 0; s < N; ++s) {
+                map[s] = states[s] == Stopped ? Rejected : states[s];
+            }
+        } else {
+            auto mapped = [](const End<E>& end) {
+                return end.stop && end.state != Terminal ? Rejected : end.state;
+            };
+
+            // Walks converging with the one from the first state share its end
+            std::vector<Index> path(static_cast<size_t>(last - first), Rejected);
+            End<E> recorded = walk<Disp>(0, first, last, &path, nullptr);
+            map[0] = mapped(recorded);
+            for (size_t s = 1; s < N; ++s) {
+                map[s] = mapped(walk<Disp>(static_cast<Index>(s), first, last, &path, &recorded));
+            }
+        }
+        return map;
+    }
+
+    template <typename F>
+    static void parallelFor(size_t n, F&& f) {
+        Workers::get().run(n, f);
+    }
+
+    // Runs the table from state over [first, last) without actions.
+    // Records the states after each event in path, or stops once the state
+    // is the one recorded, sharing the end of the recorded walk.
+    template <typename Disp, typename E>
+    static End<E> walk(
+        Index state,
+        const E* first,
+        const E* last,
+        std::vector<Index>* path,
+        const std::type_identity_t<End<E>>* recorded) {
+        for (const E* it = first; it != last; ++it) {
+            if (state == Terminal) {
+                return {state, it};
+            }
+
+            Index dst = Disp::template lookup<Policy>(state, *it).dst;
+            if (dst == Rejected) {
+                return {state, it};
+            }
+
+            state = dst == state ? state : Settled[dst];
+            if (path) {
+                Index& seen = (*path)[static_cast<size_t>(it - first)];
+                if (!recorded) {
+                    seen = state;
+                } else if (seen == state) {
+                    return *recorded;
+                }
+            }
+        }
+
+        return {state, nullptr};
+    }
+};
+
+}  // namespace impl
+
+// Feeds [first, last) to sm as sm.feedAll(first, last) does, splitting the input into
+// a chunk per thread. Each chunk is walked from every state through the compiled table
+// of policy::Dfa or policy::MinimalDfa (with a byte shuffle per event for machines with
+// less than 16 states on SSSE3 and NEON), and the walks are stitched in order, then events
+// that run actions or change the state are replayed on sm in the calling thread.
+// The chunks are walked by threads started on the first calls and kept for the next ones,
+// calls from several threads take turns, calls made while walking run in a single thread.
+// Pays off for long inputs with long runs of action-free events and machines with few states.
+// State changing onEnter transitions must not depend on guards, and the machine must not
+// raise or defer events.
+// Returns the number of consumed events.
+template <StateMachine TM, typename Policy, typename Ctx, typename E>
+size_t feedParallel(
+    SM<TM, Policy, Ctx>& sm,
+    const E* first,
+    const E* last,
+    size_t threads = std::thread::hardware_concurrency()) {
+    using Parallel = impl::Parallel<SM<TM, Policy, Ctx>>;
+    static_assert(
+        std::same_as<Policy, policy::Dfa> || std::same_as<Policy, policy::MinimalDfa>,
+        "feedParallel() walks the compiled table of policy::Dfa or policy::MinimalDfa");
+    static_assert(Parallel::Supported, "state changing onEnter transitions must be unguarded");
+    static_assert(!Parallel::Defers, "feedParallel() does not feed deferred events again");
+    static_assert(!Parallel::Raises, "feedParallel() does not follow raised events");
+
+    return Parallel::feed(sm, first, last, threads);
+}
+
+}  // namespace sml
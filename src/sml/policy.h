@@ -0,0 +1,23 @@
+#pragma once
+
+namespace sml::policy {
+
+// Dispatches an event through a per-event table of handler pointers indexed by state.
+// Smallest code size: one handler per (state, event) pair.
+struct Table {};
+
+// Dispatches an event through a switch over the state index.
+// Guards and actions can be inlined into SM::feed at the cost of code size.
+struct Switch {};
+
+// Dispatches byte events through a [state][byte] table of next states and actions
+// compiled from the whole machine. Applies to events whose guards are all value guards
+// (eq, in_range, one_of) checked before actions, other events are dispatched as with Table.
+// Fastest for lexers at the cost of 256 table entries per state.
+struct Dfa {};
+
+// Dfa over the minimized machine: states running no actions that no event tells apart
+// share a row of the table. SM::is() holds for all states merged with the current one.
+struct MinimalDfa {};
+
+}  // namespace sml::policy
@@ -0,0 +1,187 @@
+#pragma once
+
+// Native only: needs std::vector
+
+#include "sml/impl/multistate.h"
+#include "sml/impl/traits.h"
+#include "sml/sm.h"
+#include "sml/span.h"
+
+#include <supp/type_list.h>
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+
+namespace sml {
+
+// Many instances of one machine sharing a single copy of its transitions.
+// Only the current state and the context of each instance are stored, in contiguous
+// arrays; instances are fed through one SM they are swapped in and out of.
+template <StateMachine TM, typename Policy = policy::Table, typename Ctx = void>
+class SMPool {
+    using Machine = SM<TM, Policy, Ctx>;
+    using Trs = typename Machine::Trs;
+    using StateSpecs = typename Machine::StateSpecs;
+
+    static constexpr size_t N = tl::Size<StateSpecs>;
+
+    static constexpr auto Initial = Machine::template IndexOf<typename Machine::InitialSpec>;
+
+    static_assert(!Machine::HasLocals, "only the state of instances is kept, not local data");
+    static_assert(!Machine::CanDefer, "only the state of instances is kept, not deferred events");
+
+ public:
+    using StateIndex = typename Machine::StateIndex;
+    using Context = typename Machine::Context;
+
+    template <StateMachine... Machines>
+    explicit SMPool(size_t size, Machines&&... machines)
+        : sm_{std::move(machines)...}
+        , states_(size, Initial) {
+        if constexpr (Machine::HasContext) {
+            contexts_.resize(size);
+        }
+    }
+
+    size_t size() const {
+        return states_.size();
+    }
+
+    // Adds an instance in the initial state, returns its id
+    size_t add(Context ctx = {}) {
+        states_.push_back(Initial);
+        if constexpr (Machine::HasContext) {
+            contexts_.push_back(std::move(ctx));
+        }
+        return states_.size() - 1;
+    }
+
+    Context& context(size_t id)
+        requires Machine::HasContext
+    {
+        return contexts_[id];
+    }
+
+    void begin(size_t id) {
+        feed(id, OnEnterEventId{});
+    }
+
+    template <typename EId>
+    bool feed(size_t id, const EId& event) {
+        sm_.state_idx_ = states_[id];
+        if constexpr (Machine::HasContext) {
+            std::swap(sm_.ctx_, contexts_[id]);
+        }
+
+        bool accepted = sm_.feed(event);
+
+        states_[id] = sm_.state_idx_;
+        if constexpr (Machine::HasContext) {
+            std::swap(sm_.ctx_, contexts_[id]);
+        }
+        return accepted;
+    }
+
+    // Feeds events[i] to instance ids[i]. Events of one instance are fed in order,
+    // events are grouped by the state of their instance first so that instances in
+    // the same state are fed one after another.
+    // Pairs past the end of the shorter span are ignored.
+    // Returns the number of accepted events.
+    template <typename EId>
+    size_t feed(Span<size_t> ids, Span<EId> events) {
+        size_t size = std::min(ids.size(), events.size());
+
+        // Counting sort of the event indices by the state of their instance, stable
+        starts_.fill(0);
+        for (size_t i = 0; i < size; ++i) {
+            ++starts_[states_[ids.data()[i]] + 1];
+        }
+        for (size_t s = 0; s < N; ++s) {
+            starts_[s + 1] += starts_[s];
+        }
+
+        order_.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            order_[starts_[states_[ids.data()[i]]]++] = i;
+        }
+
+        size_t accepted = 0;
+        for (size_t i : order_) {
+            accepted += feed(ids.data()[i], events.data()[i]) ? 1 : 0;
+        }
+        return accepted;
+    }
+
+    // Feeds event to every instance, returns the number of instances that accepted it.
+    // For compiled byte events (see policy::Dfa) and machines with at most 16 states,
+    // the states are mapped 16 at a time through a table built for the event, which holds
+    // for all the instances as guards only test the event value. Instances in states that
+    // run actions on the event, or on leaving or entering states, are fed one by one.
+    template <typename EId>
+    size_t broadcast(const EId& event) {
+        using Dispatcher = impl::Dispatcher<EId, Trs>;
+        if constexpr (Dispatcher::Compiled && N <= impl::multistate::MaxStates) {
+            impl::multistate::Map next{};
+            impl::multistate::Map slow{};
+            impl::multistate::Map accepts{};
+            for (size_t s = 0; s < N; ++s) {
+                auto state = static_cast<StateIndex>(s);
+                auto step = Dispatcher::template lookup<Policy>(state, event);
+                bool rejected = step.dst == Dispatcher::Rejected;
+                bool transits = !rejected && step.dst != state;
+
+                bool notifies = Exits::handles(state) || Enters::handles(step.dst);
+                slow[s] = step.acts || (transits && notifies) ? 0xFF : 0;
+                next[s] = slow[s] || rejected ? state : step.dst;
+                accepts[s] = !slow[s] && !rejected;
+            }
+
+            auto fallback = [&](size_t id) { return feed(id, event); };
+            return impl::multistate::broadcast(
+                next,
+                slow,
+                accepts,
+                states_.data(),
+                states_.size(),
+                fallback);
+        } else {
+            size_t accepted = 0;
+            for (size_t id = 0; id < states_.size(); ++id) {
+                accepted += feed(id, event) ? 1 : 0;
+            }
+            return accepted;
+        }
+    }
+
+    template <StateMachine M, typename Id>
+    bool is(size_t id) const {
+        return Machine::template isIn<M, Id>(states_[id]);
+    }
+
+    // Keeps the context of the instance, as SM::reset() does
+    void reset(size_t id) {
+        states_[id] = Initial;
+    }
+
+ private:
+    // Tell whether leaving or entering each state feeds it an event it has transitions on
+    using Exits = impl::Dispatcher<OnExitEventId, Trs>;
+    using Enters = impl::Dispatcher<OnEnterEventId, Trs>;
+
+    Machine sm_;
+    std::vector<StateIndex> states_;
+    [[no_unique_address]] std::conditional_t<
+        Machine::HasContext,
+        std::vector<Context>,
+        impl::NoContext> contexts_;
+    // Buffers of feed(ids, events), kept across calls
+    std::array<size_t, N + 1> starts_{};
+    std::vector<size_t> order_;
+};
+
+}  // namespace sml
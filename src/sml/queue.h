@@ -0,0 +1,48 @@
+#pragma once
+
+#include "sml/impl/queue.h"
+#include "sml/sm.h"
+
+#include <stddef.h>
+
+namespace sml {
+
+// Bounded queue of events for an SM, lock-free with a single producer and a single consumer:
+// interrupt handlers (or another thread) post() events, the main loop feeds them to the
+// machine in loop(). Posting copies the event next to the index of its type among the
+// events of the machine and runs no machine code, so its cost does not depend on the machine.
+// Events must be trivially copyable.
+template <typename Machine, size_t Capacity>
+class EventQueue {
+ public:
+    explicit EventQueue(Machine& sm) : sm_{sm} {}
+
+    // Copies the event into the queue, returns false if the queue is full.
+    // Safe to call from an interrupt handler or a thread concurrently with loop().
+    template <typename EId>
+    bool post(const EId& event) {
+        return ring_.push(event);
+    }
+
+    // Feeds the events queued so far to the machine in order, each one run to completion
+    // before the next one. Events posted meanwhile are left for the next call.
+    // Returns the number of accepted events.
+    size_t loop() {
+        size_t accepted = 0;
+        auto feed = [&](const auto& event) { accepted += sm_.feed(event) ? 1 : 0; };
+        for (size_t queued = ring_.size(); queued != 0; --queued) {
+            ring_.pop(feed);
+        }
+        return accepted;
+    }
+
+    bool empty() const {
+        return ring_.empty();
+    }
+
+ private:
+    Machine& sm_;
+    impl::queue::Ring<typename Machine::EIds, Capacity, impl::queue::Shared> ring_;
+};
+
+}  // namespace sml
@@ -1,89 +1,477 @@
 #pragma once
 
 #include "sml/impl/dispatcher.h"
+#include "sml/impl/local.h"
+#include "sml/impl/queue.h"
 #include "sml/impl/traits.h"
+#include "sml/policy.h"
 
 namespace sml {
 
-template <StateMachine TM>
+namespace impl {
+
+template <typename SM>
+class Parallel;
+
+struct NoContext {};
+
+}  // namespace impl
+
+// Ctx is the type of the context passed by reference to the guards and actions
+// that take it as their last argument: (state, event, ctx). Each SM holds its own.
+// A root machine declaring `static constexpr size_t RaiseCapacity` gets a queue of that many
+// events for actions taking it after the context: (state, event, [ctx,] raised).
+// raised.raise(event) queues the event to be fed once the event being processed is done,
+// after its onExit and onEnter transitions, instead of feeding the machine recursively.
+// A root machine declaring `static constexpr size_t DeferCapacity` keeps up to that many
+// events led to defer, which feed() then accepts. Once a later event changes the state, they
+// are fed again in order; those the new state rejects or defers stay kept. This repeats
+// while they change the state, unless the state has no transitions on them but defer ones.
+template <StateMachine TM, typename Policy = policy::Table, typename Ctx = void>
 class SM {
+    using InitialSpec = impl::traits::StateSpec<typename TM::InitialId, TM>;
+    using M = impl::traits::CombinedStateMachine<TM>;
+    using Trs = impl::traits::Transitions<M>;
+    using TrsStorage = tl::ApplyToTemplate<Trs, impl::Storage>;
+    using EIds = impl::traits::GetEventIds<Trs>;
+    using StateSpecs = impl::traits::GetStateSpecs<Trs>;
+
+    static constexpr bool HasContext = !std::is_void_v<Ctx>;
+
+    // Capacity of the queue of events raised by actions, see above
+    static constexpr size_t RaiseCapacity = [] {
+        if constexpr (requires { TM::RaiseCapacity; }) {
+            return size_t{TM::RaiseCapacity};
+        } else {
+            return size_t{0};
+        }
+    }();
+
+    static constexpr bool CanRaise = RaiseCapacity != 0;
+
+    using Raised = std::conditional_t<
+        CanRaise,
+        impl::queue::Raised<EIds, RaiseCapacity>,
+        impl::queue::NoRaised>;
+
+    // Events of defer transitions and the capacity of their buffer, see above
+    using DeferredEIds = impl::traits::GetDeferredEventIds<Trs>;
+
+    static constexpr size_t DeferCapacity = [] {
+        if constexpr (requires { TM::DeferCapacity; }) {
+            return size_t{TM::DeferCapacity};
+        } else {
+            return size_t{0};
+        }
+    }();
+
+    static constexpr bool CanDefer = !tl::Empty<DeferredEIds>;
+
+    using Deferred = std::conditional_t<
+        CanDefer,
+        impl::queue::Ring<DeferredEIds, DeferCapacity, impl::queue::Local>,
+        impl::queue::NoDeferred>;
+
+    static_assert(!CanDefer || DeferCapacity != 0, "defer transitions need a DeferCapacity");
+    static_assert(
+        !tl::Contains<DeferredEIds, OnEnterEventId> && !tl::Contains<DeferredEIds, OnExitEventId>,
+        "onEnter and onExit cannot be deferred");
+
+    // What guards and actions may take after the state and the event
+    using Deps = tl::Concat<
+        std::conditional_t<HasContext, tl::List<Ctx>, tl::List<>>,
+        std::conditional_t<CanRaise, tl::List<Raised>, tl::List<>>>;
+
+    using Locals = impl::local::Layout<TM, Trs, StateSpecs>;
+    using Env = tl::ApplyToTemplate<tl::PushFront<Deps, Locals>, impl::local::Env>;
+
+    static constexpr bool HasLocals = Locals::Any;
+
+    static_assert(!Locals::IsRoot, "data of the root machine belongs in the context");
+    static_assert(
+        !impl::traits::EnterChains<Trs>::Cycles,
+        "unguarded onEnter transitions lead around in a cycle");
+    static_assert(
+        !HasLocals || Locals::Nested,
+        "submachines with local data must be entered from a single machine");
+
+    template <typename EId, tl::IsList Ds>
+    struct DispatcherI;
+
+    template <typename EId, typename... Ds>
+    struct DispatcherI<EId, tl::List<Ds...>> {
+        using type = impl::Dispatcher<EId, Trs, Ds...>;
+    };
+
+    template <typename EId>
+    using Dispatcher =
+        typename DispatcherI<EId, std::conditional_t<HasLocals, tl::List<Env>, Deps>>::type;
+
+ public:
+    // Type of the current state index: uint8_t for machines with less than 255 states
+    using StateIndex = impl::traits::StateIndex<StateSpecs>;
+
+    using Context = std::conditional_t<HasContext, Ctx, impl::NoContext>;
+
+ private:
+    template <typename Spec>
+    static constexpr StateIndex IndexOf = static_cast<StateIndex>(tl::Find<Spec, StateSpecs>);
+
+    template <typename EId>
+    static constexpr bool SupportsEvent = tl::Contains<EIds, EId>;
+
+    template <typename R>
+    static constexpr bool EventRange = !SupportsEvent<R> && requires(const R& r) {
+        { r.begin() != r.end() };
+        requires SupportsEvent<std::remove_cvref_t<decltype(*r.begin())>>;
+    };
+
+    using TerminalSpec = impl::traits::StateSpec<TerminalStateId, TM>;
+    static constexpr StateIndex TerminalIdx = tl::Contains<StateSpecs, TerminalSpec>
+                                                  ? IndexOf<TerminalSpec>
+                                                  : impl::traits::NoState<StateIndex>;
+
  public:
+    // A global SM of a machine with constexpr transitions() can be declared constinit,
+    // then it is built at compile time and runs no constructor code. This includes
+    // machines with data, contexts and raised or deferred events, but not local data,
+    // which is made when states are entered.
+    // Machines with data are kept for the transitions to refer to, copies of the SM
+    // refer to the machines of the original.
     template <StateMachine... Machines>
-    explicit SM(Machines&&... machines)
+    constexpr explicit SM(Machines&&... machines)
+        : machine_{std::move(machines)...}
+        , transitions_{machine_.transitions()} {
+        if constexpr (HasLocals) {
+            Locals::begin(arena_.bytes, state_idx_);
+        }
+    }
+
+    template <StateMachine... Machines>
+        requires HasContext
+    constexpr explicit SM(Context ctx, Machines&&... machines)
         : machine_{std::move(machines)...}
         , transitions_{machine_.transitions()}
-        , dispatchers_{[this] {
-            return tl::apply(
-                [&]<typename... EId>(tl::Type<EId>...) {
-                    return DispatchersTuple{impl::Dispatcher<EId, Trs>(&transitions_)...};
-                },
-                EIds{});
-        }()} {}
-
-    void begin() {
+        , ctx_{std::move(ctx)} {
+        if constexpr (HasLocals) {
+            Locals::begin(arena_.bytes, state_idx_);
+        }
+    }
+
+    // Destroys the local data of the current state and its submachines
+    ~SM()
+        requires(!Locals::TriviallyDestructible)
+    {
+        Locals::end(arena_.bytes, state_idx_);
+    }
+
+    constexpr ~SM() = default;
+
+    constexpr Context& context()
+        requires HasContext
+    {
+        return ctx_;
+    }
+
+    constexpr const Context& context() const
+        requires HasContext
+    {
+        return ctx_;
+    }
+
+    constexpr void begin() {
         feed(OnEnterEventId{});
     }
 
+    // Events raised by actions while processing the event are fed after it, then the
+    // deferred events if the state changed. Deferring an event accepts it.
     template <typename EId>
-    bool feed(const EId& event) {
+    constexpr bool feed(const EId& event) {
+        StateIndex before = state_idx_;
+        bool accepted = feedImpl(event);
+        settle(before);
+        return accepted;
+    }
+
+    // Feeds all events of the range, see feedAll()
+    template <typename R>
+        requires EventRange<R>
+    constexpr size_t feed(const R& events) {
+        if constexpr (requires { events.data() + events.size(); }) {
+            return feedAll(events.data(), events.data() + events.size());
+        } else {
+            return feedAll(events.begin(), events.end());
+        }
+    }
+
+    // Feeds events from [first, last) one by one until an event is rejected
+    // or the machine reaches its terminal state. Equivalent to calling feed()
+    // for each event, but keeps the current state local to the loop.
+    // For pointer ranges, states starting with an until<>() scan transition
+    // consume whole runs of events at once (except in constant evaluation).
+    // Returns the number of consumed events.
+    template <typename It>
+    constexpr size_t feedAll(It first, It last) {
+        using EId = std::remove_cvref_t<decltype(*first)>;
         if constexpr (SupportsEvent<EId>) {
-            return feedImpl(event);
+            size_t consumed = 0;
+            for (StateIndex state = state_idx_; first != last && state != TerminalIdx; ++first) {
+                // The scan fast path uses memchr and SIMD, not usable in constant evaluation
+                if constexpr (std::is_pointer_v<It> && Dispatcher<EId>::HasScans) {
+                    if (!std::is_constant_evaluated()) {
+                        auto run = scan(state, first, last) - first;
+                        consumed += static_cast<size_t>(run);
+                        first += run;
+                        if constexpr (CanRaise) {
+                            settle(state);
+                            state = state_idx_;
+                        }
+                        if (first == last || state == TerminalIdx) {
+                            break;
+                        }
+                    }
+                }
+
+                StateIndex dst_state = dispatch(state, *first);
+                if (dst_state == Dispatcher<EId>::Rejected) {
+                    break;
+                }
+                if constexpr (tl::Contains<DeferredEIds, EId>) {
+                    if (dst_state == Dispatcher<EId>::Deferred) {
+                        if (!deferred_.push(*first)) {
+                            break;
+                        }
+                        dst_state = state;
+                    }
+                }
+
+                ++consumed;
+                StateIndex before = state;
+                if (dst_state != state) {
+                    transit(dst_state);
+                    state = state_idx_;
+                }
+                if constexpr (CanRaise || CanDefer) {
+                    settle(before);
+                    state = state_idx_;
+                }
+            }
+
+            return consumed;
         } else {
-            return false;
+            return 0;
         }
     }
 
+    // With policy::MinimalDfa, holds for all states merged with the current one
     template <StateMachine M, typename Id>
-    bool is() const {
-        using Spec = impl::traits::StateSpec<Id, M>;
-        return state_idx_ == tl::Find<Spec, StateSpecs>;
+    constexpr bool is() const {
+        return isIn<M, Id>(state_idx_);
+    }
+
+    // Data of state Id of submachine M if it is the current state, see sml::Local
+    template <StateMachine M, typename Id>
+        requires impl::local::IsLocal<Id>
+    Id* local() {
+        return Locals::template stateIf<impl::traits::StateSpec<Id, M>>(arena_.bytes, state_idx_);
     }
 
-    void reset() {
-        state_idx_ = static_cast<int>(tl::Find<InitialSpec, StateSpecs>);
+    // Data of submachine M if the current state is one of its states or of its submachines
+    template <StateMachine M>
+        requires impl::local::IsLocal<M>
+    M* local() {
+        return Locals::template machineIf<M>(arena_.bytes, state_idx_);
+    }
+
+    // Drops the deferred events too
+    constexpr void reset() {
+        if constexpr (CanDefer) {
+            deferred_.clear();
+        }
+        if constexpr (HasLocals) {
+            Locals::end(arena_.bytes, state_idx_);
+            state_idx_ = IndexOf<InitialSpec>;
+            Locals::begin(arena_.bytes, state_idx_);
+        } else {
+            state_idx_ = IndexOf<InitialSpec>;
+        }
     }
 
  private:
-    using InitialSpec = impl::traits::StateSpec<typename TM::InitialId, TM>;
-    using M = impl::traits::CombinedStateMachine<TM>;
-    using Trs = impl::traits::Transitions<M>;
-    using TrsTuple = impl::traits::TransitionsTuple<M>;
-    using EIds = impl::traits::GetEventIds<Trs>;
-    using StateSpecs = impl::traits::GetStateSpecs<Trs>;
+    // Whether state Id of submachine M is state, see is()
+    template <StateMachine M, typename Id>
+    static constexpr bool isIn(StateIndex state) {
+        using Spec = impl::traits::StateSpec<Id, M>;
+        if constexpr (std::same_as<Policy, policy::MinimalDfa>) {
+            using Classes = impl::StateClasses<Trs>;
+            return impl::pgmRead(&Classes::Representative[state]) ==
+                   Classes::Representative[IndexOf<Spec>];
+        } else {
+            return state == IndexOf<Spec>;
+        }
+    }
 
-    struct DispatcherMapper {
-        template <typename EId>
-        using Map = impl::Dispatcher<EId, Trs>;
-    };
-    using Dispatchers = tl::Map<DispatcherMapper, EIds>;
-    using DispatchersTuple = tl::ApplyToTemplate<Dispatchers, std::tuple>;
+    // Calls f with what guards and actions may take after the state and the event
+    template <typename F>
+    constexpr decltype(auto) withDeps(F&& f) {
+        if constexpr (HasContext && CanRaise) {
+            return f(ctx_, raised_);
+        } else if constexpr (HasContext) {
+            return f(ctx_);
+        } else if constexpr (CanRaise) {
+            return f(raised_);
+        } else {
+            return f();
+        }
+    }
 
     template <typename EId>
-    static constexpr bool SupportsEvent = tl::Contains<EIds, EId>;
+    constexpr StateIndex dispatch(StateIndex state, const EId& event) {
+        return withDeps([&](auto&... deps) {
+            if constexpr (HasLocals) {
+                Env env{arena_.bytes, std::tie(deps...)};
+                return Dispatcher<EId>::template dispatch<Policy>(transitions_, state, event, env);
+            } else {
+                return Dispatcher<EId>::template dispatch<Policy>(
+                    transitions_,
+                    state,
+                    event,
+                    deps...);
+            }
+        });
+    }
+
+    template <typename EId>
+    const EId* scan(StateIndex state, const EId* first, const EId* last) {
+        return withDeps([&](auto&... deps) {
+            if constexpr (HasLocals) {
+                Env env{arena_.bytes, std::tie(deps...)};
+                return Dispatcher<EId>::scan(transitions_, state, first, last, env);
+            } else {
+                return Dispatcher<EId>::scan(transitions_, state, first, last, deps...);
+            }
+        });
+    }
+
+    // Feeds the event, leaving the events raised meanwhile queued
+    template <typename EId>
+    constexpr bool feedImpl(const EId& event) {
+        if constexpr (SupportsEvent<EId>) {
+            StateIndex dst_state = dispatch(state_idx_, event);
+            if (dst_state == Dispatcher<EId>::Rejected) {
+                return false;
+            }
+            if constexpr (tl::Contains<DeferredEIds, EId>) {
+                if (dst_state == Dispatcher<EId>::Deferred) {
+                    return deferred_.push(event);
+                }
+            }
 
-    template <typename RawEvent>
-    bool feedImpl(RawEvent event) {
-        using Dispatcher = impl::Dispatcher<RawEvent, Trs>;
-        auto&& dispatcher = std::get<Dispatcher>(dispatchers_);
+            if (dst_state != state_idx_) {
+                transit(dst_state);
+            }
 
-        int dst_state = dispatcher.dispatch(state_idx_, event);
-        if (dst_state == -1) {
+            return true;
+        } else {
             return false;
         }
+    }
 
-        if (dst_state != state_idx_) {
-            feed(OnExitEventId{});
-            state_idx_ = dst_state;
-            feed(OnEnterEventId{});
+    // Feeds the events raised by actions in order, including the ones they raise
+    constexpr void drain() {
+        if constexpr (CanRaise) {
+            auto feed = [this](const auto& event) { feedImpl(event); };
+            while (!raised_.empty()) {
+                raised_.pop(feed);
+            }
         }
+    }
+
+    // Drains the raised events, then feeds the deferred ones again if the state changed since
+    // before, in passes over all of them as long as a pass changes the state, see above
+    constexpr void settle(StateIndex before) {
+        drain();
+        if constexpr (CanDefer) {
+            constexpr auto& Accepts = impl::traits::AcceptsDeferred<Trs>;
+
+            bool changed = state_idx_ != before;
+            while (changed && impl::pgmRead(&Accepts[state_idx_])) {
+                changed = false;
+                auto replay = [this, &changed](const auto& event) {
+                    StateIndex state = state_idx_;
+                    if (!feedImpl(event)) {
+                        deferred_.push(event);
+                    }
+                    drain();
+                    changed = changed || state_idx_ != state;
+                };
+                for (size_t n = deferred_.size(); n != 0; --n) {
+                    deferred_.take(replay);
+                }
+            }
+        }
+    }
 
-        return true;
+    // Changes the state, following onEnter transitions that lead to other states in a loop
+    // rather than recursively: at most EnterChains::Longest of them one after another.
+    // Only the actions of onExit transitions run, the state they would lead to is ignored.
+    // States without onExit or onEnter transitions are skipped by a bit test, so changing
+    // between such states only stores the new index.
+    constexpr void transit(StateIndex dst_state) {
+        using Chains = impl::traits::EnterChains<Trs>;
+        constexpr size_t Rounds = Chains::Longest == Chains::NoBound ? Chains::NoBound
+                                                                      : Chains::Longest + 1;
+
+        for (size_t round = 0; round != Rounds; ++round) {
+            if constexpr (SupportsEvent<OnExitEventId>) {
+                if (Dispatcher<OnExitEventId>::handles(state_idx_)) {
+                    dispatch(state_idx_, OnExitEventId{});
+                }
+            }
+
+            if constexpr (HasLocals) {
+                StateIndex src_state = state_idx_;
+                Locals::leave(arena_.bytes, src_state, dst_state);
+                state_idx_ = dst_state;
+                Locals::enter(arena_.bytes, src_state, dst_state);
+            } else {
+                state_idx_ = dst_state;
+            }
+
+            if constexpr (SupportsEvent<OnEnterEventId>) {
+                if (!Dispatcher<OnEnterEventId>::handles(state_idx_)) {
+                    return;
+                }
+                StateIndex next = dispatch(state_idx_, OnEnterEventId{});
+                if (next == Dispatcher<OnEnterEventId>::Rejected || next == state_idx_) {
+                    return;
+                }
+                dst_state = next;
+            } else {
+                return;
+            }
+        }
     }
 
-    M machine_;
-    TrsTuple transitions_;
-    DispatchersTuple dispatchers_;
-    int state_idx_ = static_cast<int>(tl::Find<InitialSpec, StateSpecs>);
+    template <typename>
+    friend class impl::Parallel;
+
+    template <StateMachine, typename, typename>
+    friend class SMPool;
+
+    template <typename, size_t>
+    friend class EventQueue;
+
+    // Only the machines, the transitions, the context, the local data, the raised and deferred
+    // events and the state are stored: empty machines, guards, actions and contexts and unused
+    // features take no space
+    [[no_unique_address]] M machine_;
+    [[no_unique_address]] TrsStorage transitions_;
+    [[no_unique_address]] Context ctx_{};
+    [[no_unique_address]] Raised raised_{};
+    [[no_unique_address]] Deferred deferred_{};
+    [[no_unique_address]] typename Locals::Storage arena_;
+    StateIndex state_idx_ = IndexOf<InitialSpec>;
 };
 
 }  // namespace sml
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace sml {
+
+// Read-only view of a contiguous run of events
+template <typename E>
+class Span {
+ public:
+    constexpr Span(const E* first, const E* last) : first_{first}, last_{last} {}
+
+    constexpr const E* begin() const {
+        return first_;
+    }
+
+    constexpr const E* end() const {
+        return last_;
+    }
+
+    constexpr const E* data() const {
+        return first_;
+    }
+
+    constexpr size_t size() const {
+        return static_cast<size_t>(last_ - first_);
+    }
+
+    constexpr bool empty() const {
+        return first_ == last_;
+    }
+
+ private:
+    const E* first_;
+    const E* last_;
+};
+
+}  // namespace sml
@@ -1,24 +1,84 @@
 #pragma once
 
+#include "sml/impl/action.h"
+#include "sml/impl/guard.h"
+
+#include <type_traits>
 #include <utility>
 
-auto operator&&(auto a, auto b) {
-    return
-        [a = std::move(a), b = std::move(b)](auto s, const auto& e) { return a(s, e) && b(s, e); };
+namespace sml {
+
+// Guards combine with &&, || and !. Value guards (eq, in_range, one_of) fold into
+// a single value test, other guards have to be lifted first: pred(g) && eq<'a'>.
+template <typename F>
+constexpr auto pred(F f) {
+    return impl::guard::Pred<F>{std::move(f)};
 }
 
-auto operator||(auto a, auto b) {
-    return
-        [a = std::move(a), b = std::move(b)](auto s, const auto& e) { return a(s, e) || b(s, e); };
+// Actions run one after another when combined with a comma: (act(a), act(b)).
+template <typename F>
+constexpr auto act(F f) {
+    return impl::action::Act<F>{std::move(f)};
 }
 
-auto operator!(auto a) {
-    return [a = std::move(a)](auto s, const auto& e) { return !a(s, e); };
+// The global &&, || and ! and comma on any callables are gone: they matched every
+// class type in the program. Code written against them migrates by lifting the plain
+// callables, `g && h` becomes `pred(g) && pred(h)` and `(a, b)` becomes `(act(a), act(b))`.
+// Until then `using namespace sml::legacy;` brings back deprecated operators that lift
+// plain callables themselves.
+namespace legacy {
+
+namespace detail {
+
+template <typename T>
+concept Callable = std::is_class_v<T> && !impl::guard::Expr<T> && !impl::action::Expr<T>;
+
+template <typename A, typename B>
+concept Legacy = (Callable<A> || Callable<B>) && std::is_class_v<A> && std::is_class_v<B>;
+
+template <typename F>
+constexpr auto guard(F f) {
+    if constexpr (impl::guard::Expr<F>) {
+        return f;
+    } else {
+        return pred(std::move(f));
+    }
+}
+
+template <typename F>
+constexpr auto action(F f) {
+    if constexpr (impl::action::Expr<F>) {
+        return f;
+    } else {
+        return act(std::move(f));
+    }
 }
 
-auto operator,(auto a, auto b) {
-    return [a = std::move(a), b = std::move(b)](auto s, const auto& e) {
-        a(s, e);
-        b(s, e);
-    };
+}  // namespace detail
+
+template <typename A, typename B>
+    requires detail::Legacy<A, B>
+[[deprecated("lift plain guards with sml::pred()")]] constexpr auto operator&&(A a, B b) {
+    return detail::guard(std::move(a)) && detail::guard(std::move(b));
 }
+
+template <typename A, typename B>
+    requires detail::Legacy<A, B>
+[[deprecated("lift plain guards with sml::pred()")]] constexpr auto operator||(A a, B b) {
+    return detail::guard(std::move(a)) || detail::guard(std::move(b));
+}
+
+template <detail::Callable A>
+[[deprecated("lift plain guards with sml::pred()")]] constexpr auto operator!(A a) {
+    return !pred(std::move(a));
+}
+
+template <typename A, typename B>
+    requires detail::Legacy<A, B>
+[[deprecated("lift plain actions with sml::act()")]] constexpr auto operator,(A a, B b) {
+    return (detail::action(std::move(a)), detail::action(std::move(b)));
+}
+
+}  // namespace legacy
+
+}  // namespace sml
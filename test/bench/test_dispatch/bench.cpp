@@ -0,0 +1,139 @@
+#include <utest/utest.h>
+
+#if __has_include(<chrono>) && __has_include(<map>)
+
+#include "examples/kv_parser.h"
+
+#include <sml/impl/multistate.h>
+#include <sml/parallel.h>
+#include <sml/policy.h>
+#include <sml/sm.h>
+
+#include <chrono>
+#include <string>
+
+namespace sml {
+
+constexpr int kPairs = 256;
+constexpr int kRounds = 64;
+
+std::string makeInput() {
+    std::string s = "{";
+    for (int i = 0; i < kPairs; ++i) {
+        if (i > 0) {
+            s += ',';
+        }
+        s += "\"key" + std::to_string(i) + "\":\"value" + std::to_string(i) + "\"";
+    }
+    s += "}";
+    return s;
+}
+
+template <typename Policy, bool Bulk>
+double nsPerEvent(const std::string& input) {
+    using Clock = std::chrono::steady_clock;
+
+    SM<MapParser, Policy, KV> sm;
+    auto& obj = sm.context().obj;
+    size_t events = 0;
+
+    auto start = Clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        obj.clear();
+        sm.reset();
+        sm.begin();
+
+        if constexpr (Bulk) {
+            events += sm.feed(input);
+        } else {
+            for (char c : input) {
+                events += sm.feed(c);
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    TEST_ASSERT_TRUE((sm.template is<MapParser, TerminalStateId>()));
+    TEST_ASSERT_EQUAL(kPairs, obj.size());
+    TEST_ASSERT_EQUAL(input.size() * kRounds, events);
+    return elapsed / static_cast<double>(events);
+}
+
+TEST(bench_kv_parser_dispatch_policies) {
+    auto input = makeInput();
+
+    auto table = nsPerEvent<policy::Table, false>(input);
+    auto sw = nsPerEvent<policy::Switch, false>(input);
+    auto dfa = nsPerEvent<policy::Dfa, false>(input);
+    auto min_dfa = nsPerEvent<policy::MinimalDfa, false>(input);
+
+    LINFO("kv parser, policy::Table: ", table, " ns/event");
+    LINFO("kv parser, policy::Switch: ", sw, " ns/event");
+    LINFO("kv parser, policy::Dfa: ", dfa, " ns/event");
+    LINFO("kv parser, policy::MinimalDfa: ", min_dfa, " ns/event");
+}
+
+TEST(bench_kv_parser_bulk_feed) {
+    auto input = makeInput();
+
+    auto table = nsPerEvent<policy::Table, true>(input);
+    auto sw = nsPerEvent<policy::Switch, true>(input);
+    auto dfa = nsPerEvent<policy::Dfa, true>(input);
+    auto min_dfa = nsPerEvent<policy::MinimalDfa, true>(input);
+
+    LINFO("kv parser, feed(range), policy::Table: ", table, " ns/event");
+    LINFO("kv parser, feed(range), policy::Switch: ", sw, " ns/event");
+    LINFO("kv parser, feed(range), policy::Dfa: ", dfa, " ns/event");
+    LINFO("kv parser, feed(range), policy::MinimalDfa: ", min_dfa, " ns/event");
+}
+
+TEST(bench_kv_parser_multistate) {
+    using Clock = std::chrono::steady_clock;
+    using Parallel = impl::Parallel<SM<MapParser, policy::Dfa, KV>>;
+
+    auto input = makeInput();
+    const char* first = input.data();
+    const char* last = first + input.size();
+    auto events = static_cast<double>(input.size() * kRounds);
+
+    // Walks a single state, running actions
+    SM<MapParser, policy::Dfa, KV> sm;
+    auto start = Clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        sm.context().obj.clear();
+        sm.reset();
+        sm.begin();
+        for (const char* it = first; it != last; ++it) {
+            sm.feed(*it);
+        }
+    }
+    auto dispatch = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    // Walks all states at once, no actions
+    const auto& table = Parallel::ShuffleTable<char>;
+    auto map = impl::multistate::Identity;
+    start = Clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        map = impl::multistate::advance(table, map, first, last);
+    }
+    auto shuffle = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    auto shuffled = map;
+
+    map = impl::multistate::Identity;
+    start = Clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        map = impl::multistate::advanceScalar(table, map, first, last);
+    }
+    auto scalar = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    TEST_ASSERT_TRUE(map == shuffled);
+
+    LINFO("kv parser, Dispatcher::dispatch, one state: ", dispatch / events, " ns/event");
+    LINFO("kv parser, multistate::advance, all states: ", shuffle / events, " ns/event");
+    LINFO("kv parser, multistate::advanceScalar, all states: ", scalar / events, " ns/event");
+}
+
+}  // namespace sml
+
+#endif
+
+TESTS_MAIN
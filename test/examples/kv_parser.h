@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sml/make.h>
+#include <sml/overloads.h>
+#include <sml/sm.h>
+
+#include <utest/utest.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace sml {
+
+// Context of each parser: the parsed object and the pair being read
+struct KV {
+    std::map<std::string, std::string> obj;
+    std::string key;
+    std::string value;
+};
+
+struct invalid {};
+
+// Logging hooks of the parsers: Logged logs every event each machine receives through
+// a bypass transition from any of its states on any event, Quiet adds no transitions,
+// for the benchmarks and the parallel feeding tests, which measure the parsing alone
+struct Logged {
+    static constexpr auto transitions(const char* name) {
+        auto log = overloads{
+            [name](auto, char c) { LINFO(name, " received ", c); },
+            [name](auto, OnEnterEventId) { LINFO(name, " received onEnter"); },
+        };
+        return table(src<> + ev<> != log = bypass);
+    }
+};
+
+struct Quiet {
+    static constexpr auto transitions(const char*) {
+        return table();
+    }
+};
+
+template <typename Log>
+struct BasicKVParser {
+    struct wait_for_op_quote_v {};
+    struct wait_for_colon {};
+    struct reading_key {};
+    struct reading_value {};
+
+    using InitialId = reading_key;  // NOLINT
+
+    auto transitions() {
+        auto clear = [](auto, auto, KV& kv) {
+            kv.key.clear();
+            kv.value.clear();
+        };
+
+        auto append = [](std::string KV::*s) {
+            return [s](auto, Span<char> run, KV& kv) { (kv.*s).append(run.begin(), run.end()); };
+        };
+        auto add_kv = [](auto, auto, KV& kv) { kv.obj[kv.key] = kv.value; };
+
+        return std::tuple_cat(
+            Log::transitions("KVParser"),
+            table(
+                src<reading_key> + onEnter != clear,
+                src<reading_key> + ev<char> != until<'"'>(append(&KV::key)),
+                src<reading_key> + ev<char> = dst<wait_for_colon>,
+
+                src<wait_for_colon> + ev<char> == eq<':'> = dst<wait_for_op_quote_v>,
+                src<wait_for_colon> + ev<char> = dst<invalid>,
+
+                src<wait_for_op_quote_v> + ev<char> == eq<'"'> = dst<reading_value>,
+                src<wait_for_op_quote_v> + ev<char> = dst<invalid>,
+
+                src<reading_value> + ev<char> != until<'"'>(append(&KV::value)),
+                src<reading_value> + ev<char> != add_kv = x  //
+                ));
+    }
+};
+
+template <typename Log>
+struct BasicMapParser {
+    struct wait_for_op_br {};
+    struct wait_for_next_kv {};
+    struct wait_for_op_quote {};
+    using InitialId = wait_for_op_br;  // NOLINT
+
+    using KVParser = BasicKVParser<Log>;
+
+    auto transitions() {
+        return std::tuple_cat(
+            Log::transitions("MapParser"),
+            table(
+                src<wait_for_op_br> + ev<char> == eq<'{'> = dst<wait_for_op_quote>,
+                src<wait_for_op_br> + ev<char> = dst<invalid>,
+
+                src<wait_for_op_quote> + ev<char> == eq<'"'> = enter<KVParser>,
+                src<wait_for_op_quote> + ev<char> == eq<'}'> = x,
+                src<wait_for_op_quote> + ev<char> = dst<invalid>,
+
+                exit<KVParser> + onEnter = dst<wait_for_next_kv>,
+
+                src<wait_for_next_kv> + ev<char> == eq<','> = dst<wait_for_op_quote>,
+                src<wait_for_next_kv> + ev<char> == eq<'}'> = x,
+                src<wait_for_next_kv> + ev<char> = dst<invalid>  //
+                ));
+    }
+};
+
+using KVParser = BasicKVParser<Quiet>;
+using MapParser = BasicMapParser<Quiet>;
+
+}  // namespace sml
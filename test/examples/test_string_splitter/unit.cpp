@@ -4,6 +4,7 @@
 
 #include <sml/make.h>
 #include <sml/overloads.h>
+#include <sml/policy.h>
 #include <sml/sm.h>
 #include <sml/syntax.h>
 
@@ -11,12 +12,15 @@
 
 namespace sml {
 
-std::vector<std::string> words;
-char boundary;
+// Context of each splitter
+struct Split {
+    std::vector<std::string> words;
+    char boundary = ',';
+};
 
-auto new_word = [](auto...) { words.emplace_back(); };
-auto push_word = [](auto, char c) { words.back().push_back(c); };
-auto is_boundary = [](auto, char c) { return c == boundary; };
+auto new_word = [](auto, auto, Split& s) { s.words.emplace_back(); };
+auto push_word = [](auto, char c, Split& s) { s.words.back().push_back(c); };
+auto is_boundary = [](auto, char c, Split& s) { return c == s.boundary; };
 auto log = [](auto name) {
     return overloads{
         [name](auto, char c) { LINFO(name, " received ", c); },
@@ -52,10 +56,8 @@ struct Splitter {
 };
 
 TEST(test_sm_string_splitter) {
-    SM<Splitter> sm;
-
-    words.clear();
-    boundary = ',';
+    SM<Splitter, policy::Table, Split> sm;
+    const auto& words = sm.context().words;
 
     SECTION("single word") {
         sm.begin();
@@ -83,6 +85,16 @@ TEST(test_sm_string_splitter) {
         TEST_ASSERT_TRUE(expected == words);
     }
 
+    SECTION("word list fed at once") {
+        sm.begin();
+        std::string_view s = "a,b,c,d";
+        std::vector<std::string> expected{"a", "b", "c", "d"};
+
+        TEST_ASSERT_EQUAL(s.size(), sm.feed(s));
+        TEST_ASSERT_TRUE((sm.is<Word, Word::reading_word>()));
+        TEST_ASSERT_TRUE(expected == words);
+    }
+
     SECTION("empty word accepted") {
         sm.begin();
         std::string_view s = "a,,,d";
@@ -97,6 +109,17 @@ TEST(test_sm_string_splitter) {
     }
 }
 
+TEST(test_sm_string_splitter_boundary) {
+    SM<Splitter, policy::Table, Split> sm{Split{{}, ';'}};
+    sm.begin();
+
+    std::string_view s = "a,b;c";
+    std::vector<std::string> expected{"a,b", "c"};
+
+    TEST_ASSERT_EQUAL(s.size(), sm.feed(s));
+    TEST_ASSERT_TRUE(expected == sm.context().words);
+}
+
 }  // namespace sml
 
 #endif
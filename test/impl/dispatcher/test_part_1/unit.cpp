@@ -38,21 +38,17 @@ TEST(test_dispatcher_no_transition_keeps_state) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("source state does not match") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(-1, d.dispatch(1, 'a'));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 1, 'a'));
         TEST_ASSERT_EQUAL(0, c);
     }
 
     SECTION("blocked by transition condition") {
         using Disp = impl::Dispatcher<float, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(-1, d.dispatch(1, 1.f));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 1, 1.f));
         TEST_ASSERT_EQUAL(0, c);
     }
 }
@@ -78,29 +74,23 @@ TEST(test_dispatcher_transition_correct_dst_state) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("no transition destination specified") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(1, d.dispatch(1, 'a'));
+        TEST_ASSERT_EQUAL(1, Disp::dispatch(trs, 1, 'a'));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("transition destination differs from source") {
         using Disp = impl::Dispatcher<int, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(1, d.dispatch(0, 'a'));
+        TEST_ASSERT_EQUAL(1, Disp::dispatch(trs, 0, 'a'));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("transition destination is same as source") {
         using Disp = impl::Dispatcher<float, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(2, d.dispatch(2, 'a'));
+        TEST_ASSERT_EQUAL(2, Disp::dispatch(trs, 2, 'a'));
         TEST_ASSERT_EQUAL(1, c);
     }
 }
@@ -126,21 +116,17 @@ TEST(test_dispatcher_respects_transition_order) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("first transition matches") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(0, d.dispatch(1, 'b'));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 1, 'b'));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("second transition matches") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(2, d.dispatch(1, 'a'));
+        TEST_ASSERT_EQUAL(2, Disp::dispatch(trs, 1, 'a'));
         TEST_ASSERT_EQUAL(1, c);
     }
 }
@@ -165,13 +151,11 @@ TEST(test_dispatcher_bypass) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("executes transition and tests the next one") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(1, d.dispatch(0, 'b'));
+        TEST_ASSERT_EQUAL(1, Disp::dispatch(trs, 0, 'b'));
         TEST_ASSERT_EQUAL(2, c);
     }
 }
@@ -195,21 +179,17 @@ TEST(test_dispatcher_multi_event) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("matches multi event transition") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(0, d.dispatch(1, 'b'));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 1, 'b'));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("does not match, event exists") {
         using Disp = impl::Dispatcher<int, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(-1, d.dispatch(1, 10));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 1, 10));
     }
 }
 
@@ -232,21 +212,17 @@ TEST(test_dispatcher_wildcard_event) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("matches wildcard event transition") {
         using Disp = impl::Dispatcher<int, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(0, d.dispatch(1, 'b'));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 1, 'b'));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("does not match an unknown event") {
         using Disp = impl::Dispatcher<float, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(-1, d.dispatch(1, 'b'));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 1, 'b'));
         TEST_ASSERT_EQUAL(0, c);
     }
 }
@@ -273,21 +249,20 @@ TEST(test_dispatcher_multi_source) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
-    Disp d{&trs};
+    impl::Storage trs{m.transitions()};
 
     SECTION("matches multi source transition (1)") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(1, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 1, 10));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("matches multi source transition (2)") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(2, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 2, 10));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("does not match multi source transition") {
-        TEST_ASSERT_EQUAL(-1, d.dispatch(0, 10));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 0, 10));
         TEST_ASSERT_EQUAL(0, c);
     }
 }
@@ -314,21 +289,20 @@ TEST(test_dispatcher_wildcard_source) {
 
     c = 0;
     M m;
-    auto trs = m.transitions();
-    Disp d{&trs};
+    impl::Storage trs{m.transitions()};
 
     SECTION("matches wildcard source transition (1)") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(1, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 1, 10));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("matches multi source transition (2)") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(2, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 2, 10));
         TEST_ASSERT_EQUAL(1, c);
     }
 
     SECTION("matches multi source transition (3)") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(0, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 0, 10));
         TEST_ASSERT_EQUAL(1, c);
     }
 }
@@ -49,17 +49,16 @@ TEST(test_dispatcher_respects_source_state_tags) {
 
     c1 = c2 = 0;
     M m;
-    auto trs = m.transitions();
-    Disp d{&trs};
+    impl::Storage trs{m.transitions()};
 
     SECTION("chooses submachine's transition") {
-        TEST_ASSERT_EQUAL(1, d.dispatch(1, 10));
+        TEST_ASSERT_EQUAL(1, Disp::dispatch(trs, 1, 10));
         TEST_ASSERT_EQUAL(1, c1);
         TEST_ASSERT_EQUAL(0, c2);
     }
 
     SECTION("chooses outer machine's transition") {
-        TEST_ASSERT_EQUAL(0, d.dispatch(0, 10));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 0, 10));
         TEST_ASSERT_EQUAL(0, c1);
         TEST_ASSERT_EQUAL(1, c2);
     }
@@ -96,34 +95,340 @@ TEST(test_dispatcher_wildcard_events_only_local) {
 
     c1 = c2 = 0;
     M m;
-    auto trs = m.transitions();
+    impl::Storage trs{m.transitions()};
 
     SECTION("matches outer machine's wildcard event") {
         using Disp = impl::Dispatcher<float, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(0, d.dispatch(0, 1.f));
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 0, 1.f));
         TEST_ASSERT_EQUAL(0, c1);
         TEST_ASSERT_EQUAL(1, c2);
     }
 
     SECTION("submachine's event ids are not included") {
         using Disp = impl::Dispatcher<char, Ts>;
-        Disp d{&trs};
-
-        TEST_ASSERT_EQUAL(-1, d.dispatch(0, 'a'));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 0, 'a'));
         TEST_ASSERT_EQUAL(0, c1);
         TEST_ASSERT_EQUAL(0, c2);
     }
 
     SECTION("exit<> source state does not introduce an event to wildcard") {
         using Disp = impl::Dispatcher<OnExitEventId, Ts>;
-        Disp d{&trs};
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, 0, OnExitEventId{}));
+        TEST_ASSERT_EQUAL(0, c1);
+        TEST_ASSERT_EQUAL(0, c2);
+    }
+}
+
+TEST(test_dispatcher_switch_policy) {
+    static int c;
+
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<char> + ev<int> == never() = dst<float>,
+                src<char> + ev<int> != count(c) = dst<int>,
+                src<int> + ev<int> != count(c) = dst<char>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<int, Ts>;
+    // float, int, char
+
+    c = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
+
+    SECTION("matches the same transitions as the table policy") {
+        TEST_ASSERT_EQUAL(1, Disp::dispatch<policy::Switch>(trs, 2, 10));
+        TEST_ASSERT_EQUAL(2, Disp::dispatch<policy::Switch>(trs, 1, 10));
+        TEST_ASSERT_EQUAL(2, c);
+    }
+
+    SECTION("rejects in states without outbound transitions") {
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch<policy::Switch>(trs, 0, 10));
+        TEST_ASSERT_EQUAL(0, c);
+    }
+}
+
+TEST(test_dispatcher_value_table) {
+    static int c1, c2, c3;
+
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<'a'> != count(c1) = dst<float>,
+                src<int> + ev<char> != count(c2) = bypass,
+                src<int> + ev<char> == in_range<'a', 'z'> = dst<char>,
+                src<int> + ev<char> == eq<'!'> != count(c3)  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<char, Ts>;
+    // float, char, int
+
+    c1 = c2 = c3 = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
 
-        TEST_ASSERT_EQUAL(-1, d.dispatch(0, OnExitEventId{}));
+    SECTION("skips transitions whose value guards reject the event") {
+        TEST_ASSERT_EQUAL(1, Disp::dispatch(trs, 2, 'b'));
         TEST_ASSERT_EQUAL(0, c1);
+        TEST_ASSERT_EQUAL(1, c2);
+    }
+
+    SECTION("runs the first matching transition") {
+        TEST_ASSERT_EQUAL(0, Disp::dispatch(trs, 2, 'a'));
+        TEST_ASSERT_EQUAL(1, c1);
         TEST_ASSERT_EQUAL(0, c2);
     }
+
+    SECTION("keeps unguarded transitions in order") {
+        TEST_ASSERT_EQUAL(2, Disp::dispatch(trs, 2, '!'));
+        TEST_ASSERT_EQUAL(1, c2);
+        TEST_ASSERT_EQUAL(1, c3);
+    }
+
+    SECTION("rejects events no transition accepts") {
+        TEST_ASSERT_EQUAL(2, Disp::dispatch(trs, 2, '?'));  // bypass
+        TEST_ASSERT_EQUAL(1, c2);
+        TEST_ASSERT_EQUAL(0, c3);
+    }
+}
+
+TEST(test_dispatcher_dfa_policy) {
+    static int c1, c2, c3;
+
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<'a'> != count(c1) = dst<float>,
+                src<int> + ev<char> == !eq<'a'> != count(c2) = bypass,
+                src<int> + ev<char> == in_range<'a', 'z'> = dst<char>,
+                src<int> + ev<char> == eq<'!'> != count(c3),
+                src<char> + ev<char> = dst<int>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<char, Ts>;
+    // float, char, int
+
+    static_assert(Disp::Compiled);
+
+    c1 = c2 = c3 = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
+
+    SECTION("looks the next state up") {
+        TEST_ASSERT_EQUAL(1, Disp::dispatch<policy::Dfa>(trs, 2, 'b'));
+        TEST_ASSERT_EQUAL(2, Disp::dispatch<policy::Dfa>(trs, 1, '?'));
+        TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch<policy::Dfa>(trs, 0, 'a'));
+    }
+
+    SECTION("runs actions of the accepting transitions") {
+        TEST_ASSERT_EQUAL(0, Disp::dispatch<policy::Dfa>(trs, 2, 'a'));
+        TEST_ASSERT_EQUAL(1, c1);
+        TEST_ASSERT_EQUAL(0, c2);
+
+        TEST_ASSERT_EQUAL(2, Disp::dispatch<policy::Dfa>(trs, 2, '!'));
+        TEST_ASSERT_EQUAL(1, c2);
+        TEST_ASSERT_EQUAL(1, c3);
+
+        TEST_ASSERT_EQUAL(2, Disp::dispatch<policy::Dfa>(trs, 2, '?'));  // bypass
+        TEST_ASSERT_EQUAL(2, c2);
+        TEST_ASSERT_EQUAL(1, c3);
+    }
+}
+
+TEST(test_dispatcher_dfa_policy_falls_back) {
+    static int c;
+    static auto is_a = [](auto, char e) { return e == 'a'; };
+
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> != count(c) == eq<'a'> = dst<float>,
+                src<float> + ev<char> == is_a = dst<int>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<char, Ts>;
+    // float, int
+
+    static_assert(!Disp::Compiled);
+
+    c = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
+
+    TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch<policy::Dfa>(trs, 1, 'b'));
+    TEST_ASSERT_EQUAL(1, c);
+    TEST_ASSERT_EQUAL(0, Disp::dispatch<policy::Dfa>(trs, 1, 'a'));
+    TEST_ASSERT_EQUAL(1, Disp::dispatch<policy::Dfa>(trs, 0, 'a'));
+}
+
+TEST(test_dispatcher_minimal_dfa_policy) {
+    static int c;
+
+    struct a {};
+    struct b {};
+    struct invalid_a {};
+    struct invalid_b {};
+
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<'a'> = dst<a>,
+                src<int> + ev<char> == eq<'b'> = dst<b>,
+                src<int> + ev<char> == eq<'!'> != count(c) = x,
+                src<a> + ev<char> == eq<';'> = dst<int>,
+                src<a> + ev<char> = dst<invalid_a>,
+                src<b> + ev<char> == eq<';'> = dst<int>,
+                src<b> + ev<char> = dst<invalid_b>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<char, Ts>;
+    using Specs = impl::traits::GetStateSpecs<Ts>;
+    using Classes = impl::StateClasses<Ts>;
+
+    constexpr auto IndexOf = []<typename Id>(tl::Type<Id>) {
+        return static_cast<uint8_t>(tl::Find<impl::traits::StateSpec<Id, S>, Specs>);
+    };
+    constexpr auto A = IndexOf(tl::Type<a>{});
+    constexpr auto B = IndexOf(tl::Type<b>{});
+    constexpr auto Initial = IndexOf(tl::Type<int>{});
+    constexpr auto InvalidA = IndexOf(tl::Type<invalid_a>{});
+    constexpr auto InvalidB = IndexOf(tl::Type<invalid_b>{});
+    constexpr auto Terminal = IndexOf(tl::Type<TerminalStateId>{});
+
+    static_assert(Classes::Representative[A] == Classes::Representative[B]);
+    static_assert(Classes::Representative[InvalidA] == Classes::Representative[InvalidB]);
+    static_assert(Classes::Representative[A] != Classes::Representative[InvalidA]);
+    static_assert(Classes::Representative[Initial] == Initial);
+    static_assert(Classes::Representative[Terminal] == Terminal);
+
+    c = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
+
+    auto rep = [](uint8_t idx) { return Classes::Representative[idx]; };
+    TEST_ASSERT_EQUAL(rep(A), Disp::dispatch<policy::MinimalDfa>(trs, Initial, 'a'));
+    TEST_ASSERT_EQUAL(rep(A), Disp::dispatch<policy::MinimalDfa>(trs, Initial, 'b'));
+    TEST_ASSERT_EQUAL(rep(InvalidA), Disp::dispatch<policy::MinimalDfa>(trs, B, 'c'));
+    TEST_ASSERT_EQUAL(Initial, Disp::dispatch<policy::MinimalDfa>(trs, B, ';'));
+    TEST_ASSERT_EQUAL(Terminal, Disp::dispatch<policy::MinimalDfa>(trs, Initial, '!'));
+    TEST_ASSERT_EQUAL(1, c);
+}
+
+TEST(test_dispatcher_minimal_dfa_keeps_local_states) {
+    struct a {};
+    struct b : Local {};
+    struct c {};
+    struct d {};
+
+    // a, b, c and d only differ by the local data of b and the onEnter of c
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<'a'> = dst<a>,
+                src<int> + ev<char> == eq<'b'> = dst<b>,
+                src<int> + ev<char> == eq<'c'> = dst<c>,
+                src<int> + ev<char> == eq<'d'> = dst<d>,
+                src<a, b, c, d> + ev<char> == eq<';'> = dst<int>,
+                src<c> + onEnter = dst<c>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Specs = impl::traits::GetStateSpecs<Ts>;
+    using Classes = impl::StateClasses<Ts>;
+
+    constexpr auto IndexOf = []<typename Id>(tl::Type<Id>) {
+        return static_cast<uint8_t>(tl::Find<impl::traits::StateSpec<Id, S>, Specs>);
+    };
+    constexpr auto A = IndexOf(tl::Type<a>{});
+    constexpr auto B = IndexOf(tl::Type<b>{});
+    constexpr auto C = IndexOf(tl::Type<c>{});
+    constexpr auto D = IndexOf(tl::Type<d>{});
+
+    static_assert(Classes::Representative[A] == Classes::Representative[D]);
+    static_assert(Classes::Representative[B] == B);
+    static_assert(Classes::Representative[C] == C);
+}
+
+TEST(test_dispatcher_lifecycle_mask) {
+    static int c;
+
+    // Nine states, only the first and the last have onEnter transitions
+    struct S {
+        using InitialId = int;
+
+        auto transitions() {
+            return table(
+                src<int> + onEnter != count(c),
+                src<int> + ev<int> = dst<char>,
+                src<char> + ev<int> = dst<short>,
+                src<short> + ev<int> = dst<long>,
+                src<long> + ev<int> = dst<float>,
+                src<float> + ev<int> = dst<double>,
+                src<double> + ev<int> = dst<bool>,
+                src<bool> + ev<int> = dst<unsigned>,
+                src<unsigned> + ev<int> = dst<unsigned char>,
+                src<unsigned char> + onEnter != count(c) = dst<int>  //
+            );
+        }
+    };
+
+    using M = impl::traits::CombinedStateMachine<S>;
+    using Ts = impl::traits::Transitions<M>;
+    using Disp = impl::Dispatcher<OnEnterEventId, Ts>;
+    using Specs = impl::traits::GetStateSpecs<Ts>;
+    constexpr auto Int = tl::Find<impl::traits::StateSpec<int, S>, Specs>;
+    constexpr auto UChar = tl::Find<impl::traits::StateSpec<unsigned char, S>, Specs>;
+    constexpr auto Float = tl::Find<impl::traits::StateSpec<float, S>, Specs>;
+    static_assert(tl::Size<Specs> == 9);
+
+    c = 0;
+    M m;
+    impl::Storage trs{m.transitions()};
+
+    for (uint8_t state = 0; state < 9; ++state) {
+        TEST_ASSERT_EQUAL(state == Int || state == UChar, Disp::handles(state));
+    }
+
+    TEST_ASSERT_EQUAL(Int, Disp::dispatch(trs, UChar, {}));
+    TEST_ASSERT_EQUAL(Int, Disp::dispatch(trs, Int, {}));
+    TEST_ASSERT_EQUAL(Disp::Rejected, Disp::dispatch(trs, Float, {}));
+    TEST_ASSERT_EQUAL(2, c);
 }
 
 }  // namespace sml
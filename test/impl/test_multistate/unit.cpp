@@ -0,0 +1,92 @@
+#include <sml/impl/multistate.h>
+
+#include <utest/utest.h>
+
+namespace sml {
+
+using impl::multistate::Map;
+using impl::multistate::Table;
+
+// States 0..3 count 'a' modulo 4, 'b' resets, other bytes lead to 4 and stay there
+constexpr Table makeTable() {
+    Table table{};
+    for (unsigned b = 0; b < table.size(); ++b) {
+        for (uint8_t s = 0; s < 16; ++s) {
+            uint8_t next = 4;
+            if (s < 4 && b == 'a') {
+                next = (s + 1) % 4;
+            } else if (s < 4 && b == 'b') {
+                next = 0;
+            }
+            table[b][s] = next;
+        }
+    }
+    return table;
+}
+
+constexpr Table kTable = makeTable();
+
+TEST(test_multistate_advance) {
+    const char input[] = "aabaaab";
+
+    for (size_t size = 0; size < sizeof(input); ++size) {
+        Map naive = impl::multistate::Identity;
+        for (auto& s : naive) {
+            for (size_t i = 0; i < size; ++i) {
+                s = kTable[static_cast<uint8_t>(input[i])][s];
+            }
+        }
+
+        using impl::multistate::Identity;
+        auto map = impl::multistate::advance(kTable, Identity, input, input + size);
+        auto scalar = impl::multistate::advanceScalar(kTable, Identity, input, input + size);
+        TEST_ASSERT_TRUE(naive == map);
+        TEST_ASSERT_TRUE(naive == scalar);
+    }
+}
+
+TEST(test_multistate_stops) {
+    const char input[] = "aa?a";
+
+    auto map = impl::multistate::advance(kTable, impl::multistate::Identity, input, input + 4);
+    for (uint8_t s = 0; s < 16; ++s) {
+        TEST_ASSERT_EQUAL(4, map[s]);
+    }
+}
+
+TEST(test_multistate_broadcast) {
+    // 'a' from every state, state 3 is slow
+    Map next = kTable['a'];
+    Map slow{};
+    slow[3] = 0xFF;
+    next[3] = 3;
+    Map accepts{};
+    for (uint8_t s = 0; s < 3; ++s) {
+        accepts[s] = 1;
+    }
+
+    uint8_t states[41];
+    for (size_t i = 0; i < sizeof(states); ++i) {
+        states[i] = static_cast<uint8_t>(i % 5);
+    }
+
+    size_t fallbacks = 0;
+    auto fallback = [&](size_t i) {
+        TEST_ASSERT_EQUAL(3, states[i]);
+        states[i] = 0;
+        ++fallbacks;
+        return true;
+    };
+
+    size_t accepted = impl::multistate::broadcast(next, slow, accepts, states, 41, fallback);
+    TEST_ASSERT_EQUAL(8, fallbacks);
+    TEST_ASSERT_EQUAL(33, accepted);
+    for (size_t i = 0; i < sizeof(states); ++i) {
+        uint8_t expected[] = {1, 2, 3, 0, 4};
+        TEST_ASSERT_EQUAL(expected[i % 5], states[i]);
+    }
+}
+
+}  // namespace sml
+
+TESTS_MAIN
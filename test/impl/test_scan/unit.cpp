@@ -0,0 +1,56 @@
+#include <sml/impl/scan.h>
+
+#include <utest/utest.h>
+
+namespace sml {
+
+template <auto... Ds, typename E, size_t N>
+const E* naiveFind(const E (&buf)[N], size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (((buf[i] == Ds) || ...)) {
+            return buf + i;
+        }
+    }
+    return buf + size;
+}
+
+TEST(test_find_any_single_delimiter) {
+    char buf[64];
+
+    for (size_t size = 0; size <= sizeof(buf); ++size) {
+        for (size_t pos = 0; pos <= size; ++pos) {
+            for (size_t i = 0; i < size; ++i) {
+                buf[i] = i == pos ? '"' : 'a';
+            }
+
+            auto found = impl::scan::findAny<'"'>(buf + 0, buf + size);
+            TEST_ASSERT_TRUE(naiveFind<'"'>(buf, size) == found);
+        }
+    }
+}
+
+TEST(test_find_any_multiple_delimiters) {
+    char buf[64];
+
+    for (size_t size = 0; size <= sizeof(buf); ++size) {
+        for (size_t pos = 0; pos <= size; ++pos) {
+            for (size_t i = 0; i < size; ++i) {
+                buf[i] = i == pos ? ',' : (i == pos + 3 ? '}' : 'a');
+            }
+
+            auto found = impl::scan::findAny<'}', ','>(buf + 0, buf + size);
+            TEST_ASSERT_TRUE((naiveFind<'}', ','>(buf, size) == found));
+        }
+    }
+}
+
+TEST(test_find_any_non_byte_events) {
+    int buf[] = {1, 2, 3, 4, 5, 6};
+
+    TEST_ASSERT_TRUE(buf + 3 == (impl::scan::findAny<4, 6>(buf + 0, buf + 6)));
+    TEST_ASSERT_TRUE(buf + 6 == (impl::scan::findAny<7>(buf + 0, buf + 6)));
+}
+
+}  // namespace sml
+
+TESTS_MAIN
@@ -221,6 +221,133 @@ TEST(test_filter_transitions_by_src_and_event) {
     static_assert(std::same_as<ExpInt, RTsInt>);
 }
 
+template <size_t... I>
+auto makeSpecs(std::index_sequence<I...>) -> tl::List<std::integral_constant<size_t, I>...>;
+
+template <size_t N>
+using Specs = decltype(makeSpecs(std::make_index_sequence<N>{}));
+
+TEST(test_state_index) {
+    using namespace sml::impl::traits;
+
+    static_assert(std::same_as<uint8_t, StateIndex<Specs<1>>>);
+    static_assert(std::same_as<uint8_t, StateIndex<Specs<254>>>);
+    static_assert(std::same_as<uint16_t, StateIndex<Specs<255>>>);
+    static_assert(NoState<uint8_t> == 255);
+    static_assert(NoState<uint16_t> == 65535);
+}
+
+TEST(test_injection) {
+    using namespace sml::impl::traits;
+
+    using From = tl::List<int, float, char, double>;
+    using To = tl::List<char, int>;
+    constexpr auto& Inj = Injection<uint8_t, From, To>;
+
+    static_assert(Inj.size() == 4);
+    static_assert(Inj[0] == 1);
+    static_assert(Inj[1] == NoState<uint8_t>);
+    static_assert(Inj[2] == 0);
+    static_assert(Inj[3] == NoState<uint8_t>);
+}
+
+TEST(test_value_guard) {
+    using namespace sml::impl::traits;
+    using impl::guard::ByteSet;
+
+    auto g = [](auto, char) { return true; };
+    auto a = [](auto, char) {};
+
+    using T1 = decltype(src<int> + ev<char> == eq<'a', 'b'> = dst<float>);
+    using T2 = decltype(src<int> + ev<char> == in_range<'0', '9'> == one_of<"+-">);
+    using T3 = decltype(src<int> + ev<char> == eq<'a'> != a == eq<'b'>);
+    using T4 = decltype(src<int> + ev<char> == g == eq<'a'>);
+    using T5 = decltype(src<int> + ev<char> != a);
+
+    static_assert(ValueGuard<T1> == ByteSet::of('a', 'b'));
+    static_assert(ValueGuard<T2> == ByteSet{});
+    static_assert(ValueGuard<T3> == ByteSet::of('a'));
+    static_assert(ValueGuard<T4> == ByteSet::all());
+    static_assert(ValueGuard<T5> == ByteSet::all());
+    static_assert(CountValueGuarded<tl::List<T1, T2, T3, T4, T5>> == 3);
+
+    constexpr auto& First = FirstCandidate<tl::List<T3, T1, T5>>;
+    static_assert(First['a'] == 0);
+    static_assert(First['b'] == 1);
+    static_assert(First['c'] == 2);
+}
+
+TEST(test_enter_chains) {
+    using namespace sml::impl::traits;
+
+    auto g = [](auto, auto) { return true; };
+
+    // int -> float unguarded, float -> char when guarded, float -> double otherwise
+    using T1 = decltype(src<int> + onEnter = dst<float>);
+    using T2 = decltype(src<float> + onEnter == g = dst<char>);
+    using T3 = decltype(src<float> + onEnter = dst<double>);
+    using T4 = decltype(src<char> + onEnter = dst<int>);
+    using Ts = tl::List<
+        impl::transition::Tagged<T1, M1>,
+        impl::transition::Tagged<T2, M1>,
+        impl::transition::Tagged<T3, M1>>;
+    using Cyclic = tl::PushBack<Ts, impl::transition::Tagged<T4, M1>>;
+
+    using Specs = GetStateSpecs<Ts>;
+    constexpr auto Float = tl::Find<StateSpec<float, M1>, Specs>;
+    static_assert(EnterDst<StateSpec<int, M1>, Ts> == Float);
+    static_assert(EnterDst<StateSpec<float, M1>, Ts> == NoState<uint8_t>);
+    static_assert(EnterDst<StateSpec<char, M1>, Ts> == tl::Find<StateSpec<char, M1>, Specs>);
+    static_assert(EnterChains<Ts>::Longest == 2);
+    static_assert(!EnterChains<Ts>::Cycles);
+
+    // char -> int closes a cycle through the guarded transition
+    static_assert(EnterChains<Cyclic>::Longest == EnterChains<Cyclic>::NoBound);
+    static_assert(!EnterChains<Cyclic>::Cycles);
+
+    // int -> float -> int unguarded
+    using T5 = decltype(src<float> + onEnter = dst<int>);
+    static_assert(EnterChains<tl::List<
+                      impl::transition::Tagged<T1, M1>,
+                      impl::transition::Tagged<T5, M1>>>::Cycles);
+}
+
+TEST(test_settle) {
+    using namespace sml::impl::traits;
+
+    auto g = [](auto, auto) { return true; };
+    auto a = [](auto, auto) {};
+
+    // int -> float -> char pass through, char acts on entry, double has onExit
+    using T1 = decltype(src<int> + onEnter = dst<float>);
+    using T2 = decltype(src<float> + onEnter = dst<char>);
+    using T3 = decltype(src<char> + onEnter != a = dst<double>);
+    using T4 = decltype(src<double> + onEnter = dst<short>);
+    using T5 = decltype(src<double> + onExit != a);
+    using T6 = decltype(src<short> + onEnter == g = dst<int>);
+    using Ts = tl::List<
+        impl::transition::Tagged<T1, M1>,
+        impl::transition::Tagged<T2, M1>,
+        impl::transition::Tagged<T3, M1>,
+        impl::transition::Tagged<T4, M1>,
+        impl::transition::Tagged<T5, M1>,
+        impl::transition::Tagged<T6, M1>>;
+
+    using Specs = GetStateSpecs<Ts>;
+    static_assert(PassThrough<StateSpec<int, M1>, Ts>);
+    static_assert(PassThrough<StateSpec<float, M1>, Ts>);
+    static_assert(!PassThrough<StateSpec<char, M1>, Ts>);
+    static_assert(!PassThrough<StateSpec<double, M1>, Ts>);
+    static_assert(!PassThrough<StateSpec<short, M1>, Ts>);
+
+    constexpr auto Char = tl::Find<StateSpec<char, M1>, Specs>;
+    constexpr auto Double = tl::Find<StateSpec<double, M1>, Specs>;
+    static_assert(Settle<Ts>[tl::Find<StateSpec<int, M1>, Specs>] == Char);
+    static_assert(Settle<Ts>[tl::Find<StateSpec<float, M1>, Specs>] == Char);
+    static_assert(Settle<Ts>[Char] == Char);
+    static_assert(Settle<Ts>[Double] == Double);
+}
+
 }  // namespace sml
 
 TESTS_MAIN
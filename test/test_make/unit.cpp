@@ -87,6 +87,26 @@ TEST(test_transition_with_chain) {
     TEST_ASSERT_EQUAL(2, c3);
 }
 
+TEST(test_transition_with_scan) {
+    int runs = 0;
+    size_t size = 0;
+    auto t = src<int> + ev<char> != until<';'>([&](auto, Span<char> run) {
+                 ++runs;
+                 size += run.size();
+             });
+    static_assert(Transition<decltype(t)>);
+
+    TEST_ASSERT_TRUE(t(0, 'a'));
+    TEST_ASSERT_FALSE(t(0, ';'));
+    TEST_ASSERT_EQUAL(1, runs);
+
+    const char events[] = "abc;d";
+    TEST_ASSERT_TRUE(events + 3 == t.scan(0, events + 0, events + 5));
+    TEST_ASSERT_TRUE(events + 3 == t.scan(0, events + 3, events + 5));
+    TEST_ASSERT_EQUAL(2, runs);
+    TEST_ASSERT_EQUAL(4, size);
+}
+
 }  // namespace sml
 
 TESTS_MAIN
@@ -0,0 +1,162 @@
+#include <utest/utest.h>
+
+#if __has_include(<thread>) && __has_include(<map>)
+
+#include "examples/kv_parser.h"
+
+#include <sml/make.h>
+#include <sml/parallel.h>
+#include <sml/sm.h>
+
+#include <array>
+#include <string>
+#include <thread>
+
+namespace sml {
+
+std::string makeInput(int pairs) {
+    std::string s = "{";
+    for (int i = 0; i < pairs; ++i) {
+        if (i > 0) {
+            s += ',';
+        }
+        s += "\"key" + std::to_string(i) + "\":\"value" + std::to_string(i) + "\"";
+    }
+    s += "}";
+    return s;
+}
+
+TEST(test_parallel_kv_parser) {
+    auto input = makeInput(64);
+    const char* first = input.data();
+    const char* last = first + input.size();
+
+    SECTION("policy::Dfa") {
+        SM<MapParser, policy::Dfa, KV> sm;
+        auto& obj = sm.context().obj;
+        sm.begin();
+
+        TEST_ASSERT_EQUAL(input.size(), feedParallel(sm, first, last, 7));
+        TEST_ASSERT_TRUE((sm.is<MapParser, TerminalStateId>()));
+        TEST_ASSERT_EQUAL(64, obj.size());
+        TEST_ASSERT_TRUE(obj["key42"] == "value42");
+    }
+
+    SECTION("policy::MinimalDfa") {
+        SM<MapParser, policy::MinimalDfa, KV> sm;
+        auto& obj = sm.context().obj;
+        sm.begin();
+
+        TEST_ASSERT_EQUAL(input.size(), feedParallel(sm, first, last, 16));
+        TEST_ASSERT_TRUE((sm.is<MapParser, TerminalStateId>()));
+        TEST_ASSERT_EQUAL(64, obj.size());
+        TEST_ASSERT_TRUE(obj["key63"] == "value63");
+    }
+}
+
+TEST(test_parallel_stops_as_feed_all) {
+    static int digits;
+    static int entered;
+
+    struct M {
+        struct number {};
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<' '> = bypass,
+                src<int> + ev<char> == in_range<'0', '9'> = dst<number>,
+                src<int> + ev<char> == eq<'.'> = x,
+                src<number> + onEnter != [](auto...) { ++entered; },
+                src<number> + ev<char> == in_range<'0', '9'> != [](auto...) { ++digits; },
+                src<number> + ev<char> == eq<' '> = dst<int>  //
+            );
+        }
+    };
+
+    digits = entered = 0;
+    SM<M, policy::Dfa> sm;
+
+    SECTION("consumes up to the terminal state") {
+        std::string input = "1 23   456    7890 . 12";
+        const char* first = input.data();
+        TEST_ASSERT_EQUAL(20, feedParallel(sm, first, first + input.size(), 5));
+        TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+        TEST_ASSERT_EQUAL(4, entered);
+        TEST_ASSERT_EQUAL(6, digits);
+    }
+
+    SECTION("consumes up to a rejected event") {
+        std::string input = "1 23   456 ! 7890";
+        const char* first = input.data();
+        TEST_ASSERT_EQUAL(11, feedParallel(sm, first, first + input.size(), 4));
+        TEST_ASSERT_TRUE((sm.is<M, int>()));
+        TEST_ASSERT_EQUAL(3, entered);
+        TEST_ASSERT_EQUAL(3, digits);
+    }
+}
+
+struct Reset {};
+
+// 'r' raises Reset, which leads back to a: the compiled table alone misses that
+struct Raising {
+    struct a {};
+    struct b {};
+
+    using InitialId = a;  // NOLINT
+
+    static constexpr size_t RaiseCapacity = 1;
+
+    auto transitions() {
+        auto reset = [](auto, auto, auto& raised) { raised.raise(Reset{}); };
+
+        return table(
+            src<a> + ev<char> == eq<'x'> = dst<b>,
+            src<a, b> + ev<char> == eq<'.'> = bypass,
+            src<b> + ev<char> == eq<'r'> != reset,
+            src<b> + ev<Reset> = dst<a>  //
+        );
+    }
+};
+
+TEST(test_parallel_rejects_raising_machines) {
+    static_assert(impl::Parallel<SM<Raising, policy::Dfa>>::Raises);
+    static_assert(!impl::Parallel<SM<Raising, policy::Dfa>>::Defers);
+    static_assert(!impl::Parallel<SM<MapParser, policy::Dfa, KV>>::Raises);
+
+    // feedAll() follows the raised events, which feedParallel() refuses to miss
+    SM<Raising, policy::Dfa> sm;
+    std::string input = "x....r....x....r......x";
+    TEST_ASSERT_EQUAL(input.size(), sm.feed(input));
+    TEST_ASSERT_TRUE((sm.is<Raising, Raising::b>()));
+}
+
+TEST(test_parallel_reuses_workers) {
+    std::array<std::thread::id, 4> first{};
+    std::array<std::thread::id, 4> second{};
+    impl::Workers::get().run(4, [&](size_t k) { first[k] = std::this_thread::get_id(); });
+    impl::Workers::get().run(3, [&](size_t k) { second[k] = std::this_thread::get_id(); });
+
+    TEST_ASSERT_TRUE(first[0] == std::this_thread::get_id());
+    TEST_ASSERT_TRUE(first[1] != first[2] && first[2] != first[3]);
+    TEST_ASSERT_TRUE(second[1] == first[1] && second[2] == first[2]);
+    TEST_ASSERT_TRUE(second[3] == std::thread::id{});
+}
+
+TEST(test_parallel_nested_runs_are_serial) {
+    std::array<std::array<std::thread::id, 2>, 3> nested{};
+    impl::Workers::get().run(3, [&](size_t k) {
+        impl::Workers::get().run(2, [&](size_t j) { nested[k][j] = std::this_thread::get_id(); });
+    });
+
+    for (const auto& ids : nested) {
+        TEST_ASSERT_TRUE(ids[0] != std::thread::id{} && ids[0] == ids[1]);
+    }
+    TEST_ASSERT_TRUE(nested[0][0] == std::this_thread::get_id());
+}
+
+}  // namespace sml
+
+#endif
+
+TESTS_MAIN
@@ -0,0 +1,171 @@
+#include <utest/utest.h>
+
+#if __has_include(<vector>)
+
+#include <sml/make.h>
+#include <sml/pool.h>
+#include <sml/syntax.h>
+
+#include <string_view>
+#include <vector>
+
+namespace sml {
+
+struct Word {
+    struct idle {};
+    struct word {};
+
+    using InitialId = idle;  // NOLINT
+
+    auto transitions() {
+        auto count = [](auto, char) { ++words; };
+
+        return table(
+            src<idle> + ev<char> == eq<' '>,
+            src<idle> + ev<char> == in_range<'a', 'z'> != count = dst<word>,
+            src<word> + ev<char> == in_range<'a', 'z'>,
+            src<word> + ev<char> == eq<' '> = dst<idle>,
+            src<idle, word> + ev<char> == eq<'.'> = x  //
+        );
+    }
+
+    static inline int words = 0;
+};
+
+TEST(test_pool_feed) {
+    Word::words = 0;
+    SMPool<Word> pool{2};
+    TEST_ASSERT_EQUAL(2, pool.size());
+
+    TEST_ASSERT_TRUE(pool.feed(0, 'a'));
+    TEST_ASSERT_TRUE((pool.is<Word, Word::word>(0)));
+    TEST_ASSERT_TRUE((pool.is<Word, Word::idle>(1)));
+
+    TEST_ASSERT_EQUAL(2, pool.add());
+    TEST_ASSERT_TRUE(pool.feed(2, '.'));
+    TEST_ASSERT_FALSE(pool.feed(2, 'a'));
+    TEST_ASSERT_TRUE((pool.is<Word, TerminalStateId>(2)));
+
+    pool.reset(2);
+    TEST_ASSERT_TRUE((pool.is<Word, Word::idle>(2)));
+    TEST_ASSERT_EQUAL(1, Word::words);
+}
+
+TEST(test_pool_batched_feed) {
+    Word::words = 0;
+    SMPool<Word, policy::Dfa> pool{3};
+
+    // Instance 0 gets "ab c", 1 gets "x.y", 2 gets " d"
+    std::vector<size_t> ids{0, 1, 2, 0, 1, 2, 0, 1, 0};
+    std::vector<char> events{'a', 'x', ' ', 'b', '.', 'd', ' ', 'y', 'c'};
+
+    size_t accepted = pool.feed(
+        Span<size_t>{ids.data(), ids.data() + ids.size()},
+        Span<char>{events.data(), events.data() + events.size()});
+
+    TEST_ASSERT_EQUAL(8, accepted);
+    TEST_ASSERT_TRUE((pool.is<Word, Word::word>(0)));
+    TEST_ASSERT_TRUE((pool.is<Word, TerminalStateId>(1)));
+    TEST_ASSERT_TRUE((pool.is<Word, Word::word>(2)));
+    TEST_ASSERT_EQUAL(4, Word::words);
+
+    // Ids without events are ignored
+    const auto& view = pool;
+    const char q[] = "q";
+    pool.reset(0);
+    TEST_ASSERT_EQUAL(1, pool.feed(Span<size_t>{ids.data(), ids.data() + 3}, Span<char>{q, q + 1}));
+    TEST_ASSERT_TRUE((view.is<Word, Word::word>(0)));
+    TEST_ASSERT_TRUE((view.is<Word, TerminalStateId>(1)));
+    TEST_ASSERT_EQUAL(5, Word::words);
+}
+
+TEST(test_pool_broadcast) {
+    static int entered = 0;
+
+    struct Tick {
+        struct a {};
+        struct b {};
+        struct c {};
+
+        using InitialId = a;  // NOLINT
+
+        auto transitions() {
+            auto enter = [](auto...) { ++entered; };
+
+            return table(
+                src<a> + ev<char> == eq<'t'> = dst<b>,
+                src<b> + ev<char> == eq<'t'> = dst<c>,
+                src<c> + onEnter != enter,
+                src<c> + ev<char> == eq<'r'> = dst<a>  //
+            );
+        }
+    };
+
+    for (size_t size : {1, 16, 37}) {
+        entered = 0;
+        SMPool<Tick, policy::Dfa> pool{size};
+        for (size_t id = 0; id < size; id += 2) {
+            pool.feed(id, 't');
+        }
+
+        // Instances in b enter c and run its onEnter action one by one
+        size_t in_b = (size + 1) / 2;
+        TEST_ASSERT_EQUAL(size, pool.broadcast('t'));
+        TEST_ASSERT_EQUAL(int(in_b), entered);
+        for (size_t id = 0; id < size; ++id) {
+            TEST_ASSERT_TRUE(id % 2 ? (pool.is<Tick, Tick::b>(id)) : (pool.is<Tick, Tick::c>(id)));
+        }
+
+        TEST_ASSERT_EQUAL(in_b, pool.broadcast('r'));
+        TEST_ASSERT_EQUAL(0, pool.broadcast('x'));
+        for (size_t id = 0; id < size; ++id) {
+            TEST_ASSERT_TRUE(id % 2 ? (pool.is<Tick, Tick::b>(id)) : (pool.is<Tick, Tick::a>(id)));
+        }
+    }
+}
+
+TEST(test_pool_context) {
+    struct Count {
+        int words = 0;
+    };
+
+    struct M {
+        struct idle {};
+        struct word {};
+
+        using InitialId = idle;  // NOLINT
+
+        auto transitions() {
+            auto count = [](auto, char, Count& c) { ++c.words; };
+
+            return table(
+                src<idle> + ev<char> == eq<' '>,
+                src<idle> + ev<char> != count = dst<word>,
+                src<word> + ev<char> == eq<' '> = dst<idle>,
+                src<word> + ev<char>  //
+            );
+        }
+    };
+
+    SMPool<M, policy::Dfa, Count> pool{2};
+    TEST_ASSERT_EQUAL(2, pool.add(Count{10}));
+
+    for (char c : std::string_view{"ab cd"}) {
+        pool.feed(0, c);
+    }
+    pool.broadcast('x');
+
+    TEST_ASSERT_EQUAL(2, pool.context(0).words);
+    TEST_ASSERT_EQUAL(1, pool.context(1).words);
+    TEST_ASSERT_EQUAL(11, pool.context(2).words);
+
+    pool.reset(0);
+    TEST_ASSERT_TRUE((pool.is<M, M::idle>(0)));
+    TEST_ASSERT_EQUAL(2, pool.context(0).words);
+}
+
+}  // namespace sml
+
+#endif
+
+TESTS_MAIN
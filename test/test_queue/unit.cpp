@@ -0,0 +1,95 @@
+#include <sml/make.h>
+#include <sml/queue.h>
+#include <sml/sm.h>
+#include <sml/syntax.h>
+
+#include <utest/utest.h>
+
+#if __has_include(<thread>)
+#include <thread>
+#endif
+
+namespace sml {
+
+struct Reading {
+    uint16_t value;
+};
+
+// Sums readings while on, chars switch it on and off
+struct Meter {
+    struct off {};
+    struct on {};
+
+    using InitialId = off;  // NOLINT
+
+    auto transitions() {
+        auto add = [](auto, Reading r, long& sum) { sum += r.value; };
+
+        return table(
+            src<off> + ev<char> == eq<'+'> = dst<on>,
+            src<on> + ev<char> == eq<'-'> = dst<off>,
+            src<on> + ev<Reading> != add  //
+        );
+    }
+};
+
+TEST(test_queue_post_and_loop) {
+    SM<Meter, policy::Table, long> sm;
+    EventQueue<decltype(sm), 4> queue{sm};
+    TEST_ASSERT_TRUE(queue.empty());
+
+    TEST_ASSERT_TRUE(queue.post(Reading{1}));
+    TEST_ASSERT_TRUE(queue.post('+'));
+    TEST_ASSERT_TRUE(queue.post(Reading{2}));
+    TEST_ASSERT_TRUE(queue.post(Reading{3}));
+    TEST_ASSERT_FALSE(queue.post('-'));
+    TEST_ASSERT_FALSE(queue.empty());
+
+    // Nothing runs until loop()
+    TEST_ASSERT_TRUE((sm.is<Meter, Meter::off>()));
+    TEST_ASSERT_EQUAL(3, queue.loop());
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL(5, sm.context());
+
+    // Wraps around
+    for (int round = 0; round < 3; ++round) {
+        TEST_ASSERT_TRUE(queue.post(Reading{10}));
+        TEST_ASSERT_TRUE(queue.post('-'));
+        TEST_ASSERT_TRUE(queue.post('+'));
+        TEST_ASSERT_EQUAL(3, queue.loop());
+    }
+    TEST_ASSERT_EQUAL(35, sm.context());
+    TEST_ASSERT_EQUAL(0, queue.loop());
+}
+
+#if __has_include(<thread>)
+
+TEST(test_queue_concurrent_producer) {
+    constexpr uint16_t N = 20000;
+
+    SM<Meter, policy::Table, long> sm;
+    EventQueue<decltype(sm), 16> queue{sm};
+    queue.post('+');
+
+    std::thread producer([&] {
+        for (uint16_t i = 1; i <= N; ++i) {
+            while (!queue.post(Reading{i})) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    size_t accepted = 0;
+    while (accepted < N + 1) {
+        accepted += queue.loop();
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(long{N} * (N + 1) / 2, sm.context());
+}
+
+#endif
+
+}  // namespace sml
+
+TESTS_MAIN
@@ -4,6 +4,12 @@
 
 #include <utest/utest.h>
 
+#include <array>
+#include <string_view>
+#include <type_traits>
+
+#include <string.h>
+
 namespace sml {
 
 auto count(int& c) {
@@ -170,6 +176,787 @@ TEST(test_sm_saves_new_state_if_needed) {
     }
 }
 
+TEST(test_sm_switch_policy) {
+    static int c;
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<int> != count(c) = dst<float>,
+                src<int> + onExit != count(c),
+                src<float> + onEnter != count(c),
+                src<float> + ev<float> != count(c) = dst<int>  //
+            );
+        }
+    };
+
+    c = 0;
+    SM<M, policy::Switch> sm;
+
+    TEST_ASSERT_FALSE(sm.feed(1.f));
+    TEST_ASSERT_TRUE(sm.feed(10));
+    TEST_ASSERT_EQUAL(3, c);
+    TEST_ASSERT_TRUE((sm.is<M, float>()));
+    TEST_ASSERT_TRUE(sm.feed(1.f));
+    TEST_ASSERT_EQUAL(4, c);
+    TEST_ASSERT_TRUE((sm.is<M, int>()));
+}
+
+TEST(test_sm_dfa_policy) {
+    static int c;
+    static size_t size;
+
+    static auto add_size = [](auto, Span<char> run) { size += run.size(); };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == in_range<'0', '9'> != count(c) = dst<float>,
+                src<int> + ev<char> == eq<' '> = bypass,
+                src<float> + ev<char> == eq<';'> = x,
+                src<float> + ev<char> != until<';'>(add_size),
+                src<float> + onEnter != count(c)  //
+            );
+        }
+    };
+
+    c = 0;
+    size = 0;
+    SM<M, policy::Dfa> sm;
+
+    SECTION("feeds single events") {
+        TEST_ASSERT_TRUE(sm.feed(' '));
+        TEST_ASSERT_FALSE(sm.feed('a'));
+        TEST_ASSERT_TRUE(sm.feed('1'));
+        TEST_ASSERT_EQUAL(2, c);
+        TEST_ASSERT_TRUE((sm.is<M, float>()));
+        TEST_ASSERT_TRUE(sm.feed('a'));
+        TEST_ASSERT_TRUE(sm.feed(';'));
+        TEST_ASSERT_EQUAL(1, size);
+        TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+    }
+
+    SECTION("feeds ranges") {
+        std::array<char, 6> events{' ', '1', 'a', 'b', ';', 'c'};
+        TEST_ASSERT_EQUAL(5, sm.feed(events));
+        TEST_ASSERT_EQUAL(2, c);
+        TEST_ASSERT_EQUAL(2, size);
+        TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+    }
+}
+
+TEST(test_sm_minimal_dfa_policy) {
+    struct a {};
+    struct b {};
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == eq<'a'> = dst<a>,
+                src<int> + ev<char> == eq<'b'> = dst<b>,
+                src<a, b> + ev<char> == eq<';'> = dst<int>,
+                src<int> + ev<char> == eq<'.'> = x  //
+            );
+        }
+    };
+
+    SM<M, policy::MinimalDfa> sm;
+
+    std::array<char, 4> events{'a', ';', 'b', '?'};
+    TEST_ASSERT_EQUAL(3, sm.feed(events));
+    TEST_ASSERT_TRUE((sm.is<M, a>()));
+    TEST_ASSERT_TRUE((sm.is<M, b>()));  // merged with a
+    TEST_ASSERT_FALSE((sm.is<M, int>()));
+    TEST_ASSERT_TRUE(sm.feed(';'));
+    TEST_ASSERT_TRUE(sm.feed('.'));
+    TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+}
+
+TEST(test_sm_feed_range) {
+    static int c;
+    static auto is = [](char x) { return [x](auto, char e) { return e == x; }; };
+    static auto is_not = [](char x) { return [x](auto, char e) { return e != x; }; };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> == is('.') != count(c) = x,
+                src<int> + ev<char> == is('f') != count(c) = dst<float>,
+                src<float> + ev<char> == is('i') != count(c) = dst<int>,
+                src<int, float> + onEnter != count(c),
+                src<int, float> + onExit != count(c),
+                src<int> + ev<char> == is_not('!') != count(c)  //
+            );
+        }
+    };
+
+    c = 0;
+    SM<M> sm;
+
+    SECTION("consumes all events") {
+        std::array<char, 3> events{'a', 'b', 'c'};
+        TEST_ASSERT_EQUAL(3, sm.feed(events));
+        TEST_ASSERT_EQUAL(3, c);
+    }
+
+    SECTION("stops on a rejected event") {
+        std::array<char, 5> events{'a', 'b', '!', 'c', 'd'};
+        TEST_ASSERT_EQUAL(2, sm.feedAll(events.begin(), events.end()));
+        TEST_ASSERT_EQUAL(2, c);
+    }
+
+    SECTION("stops in the terminal state") {
+        std::array<char, 4> events{'a', '.', 'c', 'd'};
+        TEST_ASSERT_EQUAL(2, sm.feed(events));
+        TEST_ASSERT_EQUAL(3, c);  // 'a', '.', onExit
+        TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+        TEST_ASSERT_EQUAL(0, sm.feed(events));
+    }
+
+    SECTION("feeds enter and exit events as feed() does") {
+        std::array<char, 4> events{'f', 'i', 'f', 'a'};
+        TEST_ASSERT_EQUAL(3, sm.feed(events));
+        TEST_ASSERT_EQUAL(3 + 3 * 2, c);
+        TEST_ASSERT_TRUE((sm.is<M, float>()));
+    }
+}
+
+TEST(test_sm_scan_transition) {
+    static int runs;
+    static std::array<char, 8> buf;
+    static size_t size;
+
+    static auto append = [](auto, Span<char> run) {
+        ++runs;
+        for (char c : run) {
+            buf[size++] = c;
+        }
+    };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> != until<';', '.'>(append),
+                src<int> + ev<char> = dst<float>,
+                src<float> + ev<char> = dst<int>  //
+            );
+        }
+    };
+
+    runs = 0;
+    size = 0;
+    SM<M> sm;
+
+    SECTION("consumes single events up to a delimiter") {
+        TEST_ASSERT_TRUE(sm.feed('a'));
+        TEST_ASSERT_TRUE(sm.feed('b'));
+        TEST_ASSERT_TRUE(sm.feed(';'));
+        TEST_ASSERT_TRUE((sm.is<M, float>()));
+        TEST_ASSERT_EQUAL(2, runs);
+        TEST_ASSERT_EQUAL(2, size);
+    }
+
+    SECTION("consumes contiguous runs at once") {
+        std::array<char, 9> events{'a', 'b', 'c', '.', 'x', 'd', ';', 'x', 'e'};
+        TEST_ASSERT_EQUAL(9, sm.feed(events));
+        TEST_ASSERT_TRUE((sm.is<M, int>()));
+        TEST_ASSERT_EQUAL(3, runs);
+        TEST_ASSERT_EQUAL(5, size);
+        TEST_ASSERT_EQUAL('a', buf[0]);
+        TEST_ASSERT_EQUAL('d', buf[3]);
+        TEST_ASSERT_EQUAL('e', buf[4]);
+    }
+}
+
+TEST(test_sm_scan_transition_after_other_transitions) {
+    static int c;
+    static size_t size;
+
+    static auto add_size = [](auto, Span<char> run) { size += run.size(); };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<char> != count(c) = bypass,  // runs for every event
+                src<int> + ev<char> != until<';'>(add_size),
+                src<int> + ev<char> = dst<float>  //
+            );
+        }
+    };
+
+    c = 0;
+    size = 0;
+    SM<M> sm;
+
+    std::array<char, 4> events{'a', 'b', 'c', ';'};
+    TEST_ASSERT_EQUAL(4, sm.feed(events));
+    TEST_ASSERT_TRUE((sm.is<M, float>()));
+    TEST_ASSERT_EQUAL(4, c);
+    TEST_ASSERT_EQUAL(3, size);
+}
+
+struct Number {
+    int* value;
+
+    using InitialId = int;  // NOLINT
+
+    constexpr auto transitions() {
+        auto push_digit = [value = value](auto, char c) { *value = *value * 10 + (c - '0'); };
+        auto add_run = [value = value](auto, Span<char> run) { *value += int(run.size()); };
+
+        return table(
+            src<int> + ev<char> == in_range<'0', '9'> != push_digit,
+            src<int> + ev<char> == eq<'+'> = dst<float>,
+            src<float> + ev<char> != until<';'>(add_run),
+            src<float> + ev<char> = x  //
+        );
+    }
+};
+
+template <typename Policy, size_t N>
+constexpr int parseNumber(const char (&s)[N]) {
+    int value = 0;
+    SM<Number, Policy> sm{Number{&value}};
+    sm.begin();
+
+    Span<char> events{s, s + N - 1};
+    bool parsed = sm.feed(events) == events.size() && sm.template is<Number, TerminalStateId>();
+    return parsed ? value : -1;
+}
+
+TEST(test_sm_constant_evaluation) {
+    static_assert(parseNumber<policy::Table>("123+ab;") == 125);
+    static_assert(parseNumber<policy::Switch>("42+;") == 42);
+    static_assert(parseNumber<policy::Dfa>("7+abc;") == 10);
+    static_assert(parseNumber<policy::MinimalDfa>("7+abc") == -1);
+
+    TEST_ASSERT_EQUAL(125, parseNumber<policy::Table>("123+ab;"));
+}
+
+int toggles = 0;
+
+struct Toggle {
+    struct on {};
+    struct off {};
+
+    using InitialId = off;  // NOLINT
+
+    constexpr auto transitions() {
+        auto toggle = [](auto...) { ++toggles; };
+
+        return table(
+            src<off> + ev<char> == eq<'1'> != toggle = dst<on>,
+            src<on> + ev<char> == eq<'0'> != toggle = dst<off>  //
+        );
+    }
+};
+
+constinit SM<Toggle> toggle;
+
+TEST(test_sm_constinit) {
+    toggles = 0;
+    toggle.reset();
+
+    TEST_ASSERT_TRUE((toggle.is<Toggle, Toggle::off>()));
+    TEST_ASSERT_TRUE(toggle.feed('1'));
+    TEST_ASSERT_FALSE(toggle.feed('1'));
+    TEST_ASSERT_TRUE(toggle.feed('0'));
+    TEST_ASSERT_EQUAL(2, toggles);
+}
+
+TEST(test_sm_state_index_is_compact) {
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<int> = dst<float>,
+                src<float> + ev<int> = dst<char>  //
+            );
+        }
+    };
+
+    static_assert(std::same_as<uint8_t, SM<M>::StateIndex>);
+    static_assert(sizeof(SM<M>) == sizeof(uint8_t));
+}
+
+TEST(test_sm_stateless_machine_is_state_index_sized) {
+    static int c = 0;
+
+    struct S {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(src<int> + ev<char> == eq<'.'> = x);
+        }
+    };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto inc = [](auto...) { ++c; };
+            auto twice = [](auto...) { c += 2; };
+            auto odd = [](auto, char e) { return e % 2 == 1; };
+
+            return table(
+                src<int> + ev<char> == (pred(odd) && !eq<'a'>) != (act(inc), act(twice)),
+                src<int> + ev<char> == one_of<"xy"> = dst<float>,
+                src<float> + ev<char> != until<';'>([](auto, Span<char>) { ++c; }),
+                src<float> + ev<char> = enter<S>,
+                exit<S> + onEnter != inc = dst<int>  //
+            );
+        }
+    };
+
+    static_assert(sizeof(SM<M>) == sizeof(SM<M>::StateIndex));
+
+    c = 0;
+    SM<M> sm;
+    const char events[] = "cxab;.";
+    TEST_ASSERT_EQUAL(6, sm.feedAll(events, events + 6));
+    TEST_ASSERT_TRUE((sm.is<M, int>()));
+    TEST_ASSERT_EQUAL(5, c);
+}
+
+struct Count {
+    int* c;
+
+    void operator()(auto...) {
+        ++*c;
+    }
+};
+
+TEST(test_sm_is_relocatable) {
+    struct M {
+        int* c;
+
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            return table(
+                src<int> + ev<int> != Count{c} = dst<float>,
+                src<float> + ev<int> != Count{c} = dst<int>  //
+            );
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<SM<M>>);
+
+    int c = 0;
+    std::array<SM<M>, 2> sms{SM<M>{M{&c}}, SM<M>{M{&c}}};
+    TEST_ASSERT_TRUE(sms[0].feed(1));
+
+    SM<M> copy = sms[0];
+    TEST_ASSERT_TRUE((copy.is<M, float>()));
+    TEST_ASSERT_TRUE(copy.feed(1));
+    TEST_ASSERT_TRUE((copy.is<M, int>()));
+    TEST_ASSERT_TRUE((sms[0].is<M, float>()));
+
+    memcpy(static_cast<void*>(&sms[1]), &sms[0], sizeof(SM<M>));
+    TEST_ASSERT_TRUE((sms[1].is<M, float>()));
+    TEST_ASSERT_TRUE(sms[1].feed(1));
+    TEST_ASSERT_TRUE((sms[1].is<M, int>()));
+    TEST_ASSERT_EQUAL(3, c);
+}
+
+TEST(test_sm_keeps_machines) {
+    struct M {
+        int limit;
+        int count = 0;
+
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto below = [this](auto, auto) { return count < limit; };
+            auto inc = [this](auto, auto) { ++count; };
+
+            return table(src<int> + ev<char> == pred(below) != inc);
+        }
+    };
+
+    SM<M> sm{M{2}};
+    const char events[] = "abc";
+    TEST_ASSERT_EQUAL(2, sm.feedAll(events, events + 3));
+}
+
+TEST(test_sm_context) {
+    struct Digits {
+        int value = 0;
+        int runs = 0;
+    };
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto push = [](auto, char c, Digits& d) { d.value = d.value * 10 + (c - '0'); };
+            auto small = [](auto, auto, Digits& d) { return d.value < 100; };
+            auto count = [](auto, Span<char>, Digits& d) { ++d.runs; };
+
+            return table(
+                src<int> + ev<char> == (pred(small) && in_range<'0', '9'>) != push,
+                src<int> + ev<char> == eq<'+'> = dst<float>,
+                src<float> + ev<char> != until<';'>(count)  //
+            );
+        }
+    };
+
+    SM<M, policy::Table, Digits> sm{Digits{1, 0}};
+    const char events[] = "23456+ab";
+    TEST_ASSERT_EQUAL(2, sm.feedAll(events, events + 8));
+    TEST_ASSERT_EQUAL(123, sm.context().value);
+
+    SM<M, policy::Switch, Digits> other;
+    TEST_ASSERT_EQUAL(5, other.feedAll(events + 3, events + 8));
+    TEST_ASSERT_EQUAL(56, other.context().value);
+    TEST_ASSERT_EQUAL(1, other.context().runs);
+    TEST_ASSERT_EQUAL(123, sm.context().value);
+
+    struct Empty {};
+    using Stateless = SM<M, policy::Table, Empty>;
+    static_assert(sizeof(Stateless) == sizeof(Stateless::StateIndex));
+}
+
+TEST(test_sm_enter_chain) {
+    static char log[16] = {};
+    static int size = 0;
+
+    // Each state but the last passes on to the next one on entry
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto exit = [](auto, auto) { log[size++] = 'x'; };
+            auto enter = [](auto, auto) { log[size++] = 'e'; };
+
+            return table(
+                src<int> + ev<char> = dst<char>,
+                src<char, short, long> + onExit != exit,
+                src<char> + onEnter != enter = dst<short>,
+                src<short> + onEnter = dst<long>,
+                src<long> + onEnter = dst<float>,
+                src<float> + onEnter != enter  //
+            );
+        }
+    };
+
+    using Trs = impl::traits::Transitions<impl::traits::CombinedStateMachine<M>>;
+    static_assert(impl::traits::EnterChains<Trs>::Longest == 3);
+
+    SM<M> sm;
+    TEST_ASSERT_TRUE(sm.feed('a'));
+    TEST_ASSERT_TRUE((sm.is<M, float>()));
+    TEST_ASSERT_EQUAL(0, strcmp(log, "exxxe"));
+}
+
+TEST(test_sm_pass_through) {
+    static char log[16] = {};
+    static int size = 0;
+
+    // short and long only pass on to the next state, transitions into them go to float
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto exit = [](auto, auto) { log[size++] = 'x'; };
+            auto enter = [](auto, auto) { log[size++] = 'e'; };
+
+            return table(
+                src<int> + ev<char> = dst<short>,
+                src<int> + onExit != exit,
+                src<short> + onEnter = dst<long>,
+                src<long> + onEnter = dst<float>,
+                src<float> + onEnter != enter,
+                src<float> + ev<char> = dst<int>  //
+            );
+        }
+    };
+
+    using Trs = impl::traits::Transitions<impl::traits::CombinedStateMachine<M>>;
+    using Dispatcher = impl::Dispatcher<char, Trs>;
+    using Specs = impl::traits::GetStateSpecs<Trs>;
+    constexpr auto Int = tl::Find<impl::traits::StateSpec<int, M>, Specs>;
+    constexpr auto Float = tl::Find<impl::traits::StateSpec<float, M>, Specs>;
+    static_assert(Dispatcher::lookup<policy::Dfa>(Int, 'a').dst == Float);
+
+    SM<M> sm;
+    TEST_ASSERT_TRUE(sm.feed('a'));
+    TEST_ASSERT_TRUE((sm.is<M, float>()));
+    TEST_ASSERT_TRUE(sm.feed('b'));
+    TEST_ASSERT_TRUE(sm.feed('c'));
+    TEST_ASSERT_TRUE((sm.is<M, float>()));
+    TEST_ASSERT_EQUAL(0, strcmp(log, "xexe"));
+
+    // Passing back to the source state leaves it and enters it again
+    struct Back {
+        using InitialId = float;  // NOLINT
+
+        auto transitions() {
+            auto exit = [](auto, auto) { log[size++] = 'x'; };
+            auto enter = [](auto, auto) { log[size++] = 'e'; };
+
+            return table(
+                src<float> + ev<char> = dst<short>,
+                src<short> + onEnter = dst<float>,
+                src<float> + onExit != exit,
+                src<float> + onEnter != enter  //
+            );
+        }
+    };
+
+    std::fill(std::begin(log), std::end(log), 0);
+    size = 0;
+    SM<Back> back;
+    TEST_ASSERT_TRUE(back.feed('a'));
+    TEST_ASSERT_TRUE((back.is<Back, float>()));
+    TEST_ASSERT_EQUAL(0, strcmp(log, "xe"));
+}
+
+struct Tick {
+    int n;
+};
+
+struct Log {
+    char text[16] = {};
+    int size = 0;
+    int dropped = 0;
+
+    void add(char c) {
+        text[size++] = c;
+    }
+};
+
+// Raises as many ticks as the digit it is fed, the second one ends the run.
+// Local classes cannot declare RaiseCapacity.
+struct Ticker {
+    struct idle {};
+    struct busy {};
+
+    using InitialId = idle;  // NOLINT
+
+    static constexpr size_t RaiseCapacity = 2;
+
+    constexpr auto transitions() {
+        auto log = [](char c) { return [c](auto, auto, Log& l) { l.add(c); }; };
+        auto start = [](auto, char c, Log& l, auto& raised) {
+            l.add('r');
+            for (int n = 0; n < c - '0'; ++n) {
+                l.dropped += raised.raise(Tick{n}) ? 0 : 1;
+            }
+        };
+        auto tick = [](auto, Tick t, Log& l) { l.add(static_cast<char>('0' + t.n)); };
+
+        return table(
+            src<idle> + ev<char> != start = dst<busy>,
+            src<idle> + onExit != log('x'),
+            src<idle> + onEnter != log('i'),
+            src<busy> + onEnter != log('e'),
+            src<busy> + ev<Tick> == [](auto, Tick t) { return t.n == 0; } != tick,
+            src<busy> + ev<Tick> != tick = dst<idle>  //
+        );
+    }
+};
+
+TEST(test_sm_raise) {
+    // Raised events are fed once the transition is done, in order
+    SM<Ticker, policy::Table, Log> sm;
+    TEST_ASSERT_TRUE(sm.feed('3'));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "rxe01i"));
+    TEST_ASSERT_EQUAL(1, sm.context().dropped);
+    TEST_ASSERT_TRUE((sm.is<Ticker, Ticker::idle>()));
+
+    SM<Ticker, policy::Switch, Log> other;
+    TEST_ASSERT_EQUAL(2, other.feed(std::string_view{"22"}));
+    TEST_ASSERT_EQUAL(0, strcmp(other.context().text, "rxe01irxe01i"));
+    TEST_ASSERT_EQUAL(0, other.context().dropped);
+}
+
+struct Cmd {
+    char c;
+};
+
+struct Ack {};
+struct Close {};
+
+// Commands sent before the handshake is acknowledged wait for it, '!' restarts it.
+// Local classes cannot declare DeferCapacity.
+struct Handshake {
+    struct connecting {};
+    struct ready {};
+    struct closed {};
+
+    using InitialId = connecting;  // NOLINT
+
+    static constexpr size_t DeferCapacity = 2;
+
+    constexpr auto transitions() {
+        auto bang = [](auto, Cmd cmd) { return cmd.c == '!'; };
+        auto run = [](auto, Cmd cmd, Log& l) { l.add(cmd.c); };
+
+        return table(
+            src<connecting> + ev<Cmd> = defer,
+            src<connecting> + ev<Ack> = dst<ready>,
+            src<connecting> + ev<Close> = dst<closed>,
+            src<closed> + ev<Ack> = dst<ready>,
+            src<ready> + ev<Cmd> == bang = dst<connecting>,
+            src<ready> + ev<Cmd> != run,
+            src<ready> + ev<Close> = dst<connecting>  //
+        );
+    }
+};
+
+TEST(test_sm_defer) {
+    using Trs = impl::traits::Transitions<impl::traits::CombinedStateMachine<Handshake>>;
+    using Specs = impl::traits::GetStateSpecs<Trs>;
+    constexpr auto& Accepts = impl::traits::AcceptsDeferred<Trs>;
+    static_assert(Accepts[tl::Find<impl::traits::StateSpec<Handshake::ready, Handshake>, Specs>]);
+    static_assert(!Accepts[tl::Find<impl::traits::StateSpec<Handshake::closed, Handshake>, Specs>]);
+    static_assert(std::is_same_v<impl::traits::GetDeferredEventIds<Trs>, tl::List<Cmd>>);
+
+    SM<Handshake, policy::Table, Log> sm;
+    TEST_ASSERT_TRUE(sm.feed(Cmd{'a'}));
+    TEST_ASSERT_TRUE(sm.feed(Cmd{'b'}));
+    TEST_ASSERT_FALSE(sm.feed(Cmd{'c'}));
+
+    // Kept in closed, which has no transitions on commands
+    TEST_ASSERT_TRUE(sm.feed(Close{}));
+    TEST_ASSERT_TRUE(sm.feed(Ack{}));
+    TEST_ASSERT_TRUE((sm.is<Handshake, Handshake::ready>()));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "ab"));
+
+    TEST_ASSERT_TRUE(sm.feed(Close{}));
+    std::array<Cmd, 2> cmds{{{'c'}, {'d'}}};
+    TEST_ASSERT_EQUAL(2, sm.feed(cmds));
+    TEST_ASSERT_TRUE(sm.feed(Ack{}));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "abcd"));
+
+    // '!' leads back to connecting, where e is deferred again
+    TEST_ASSERT_TRUE(sm.feed(Close{}));
+    TEST_ASSERT_TRUE(sm.feed(Cmd{'!'}));
+    TEST_ASSERT_TRUE(sm.feed(Cmd{'e'}));
+    TEST_ASSERT_TRUE(sm.feed(Ack{}));
+    TEST_ASSERT_TRUE((sm.is<Handshake, Handshake::connecting>()));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "abcd"));
+    TEST_ASSERT_TRUE(sm.feed(Ack{}));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "abcde"));
+
+    TEST_ASSERT_TRUE(sm.feed(Close{}));
+    TEST_ASSERT_TRUE(sm.feed(Cmd{'f'}));
+    sm.reset();
+    TEST_ASSERT_TRUE(sm.feed(Ack{}));
+    TEST_ASSERT_EQUAL(0, strcmp(sm.context().text, "abcde"));
+}
+
+constinit SM<Ticker, policy::Table, Log> ticker;
+constinit SM<Handshake, policy::Table, Log> handshake{Log{{'>'}, 1, 0}};
+
+TEST(test_sm_constinit_queues) {
+    TEST_ASSERT_TRUE(ticker.feed('1'));
+    TEST_ASSERT_EQUAL(0, strcmp(ticker.context().text, "rxe0"));
+
+    TEST_ASSERT_TRUE(handshake.feed(Cmd{'a'}));
+    TEST_ASSERT_TRUE(handshake.feed(Ack{}));
+    TEST_ASSERT_EQUAL(0, strcmp(handshake.context().text, ">a"));
+}
+
+// Counts live instances
+struct Tracked : Local {
+    Tracked() {
+        ++alive;
+    }
+
+    Tracked(const Tracked&) = delete;
+
+    ~Tracked() {
+        --alive;
+    }
+
+    static inline int alive = 0;
+};
+
+TEST(test_sm_local_data) {
+    static int saved = 0;
+
+    struct Sub : Tracked {
+        struct a : Tracked {};
+
+        using InitialId = a;  // NOLINT
+
+        auto transitions() {
+            return table(src<a> + ev<char> == eq<'.'> = x);
+        }
+    };
+
+    struct M {
+        struct idle {};
+        struct number : Local {
+            int value = 0;
+        };
+
+        using InitialId = idle;  // NOLINT
+
+        auto transitions() {
+            auto push = [](number& n, char c) { n.value = n.value * 10 + (c - '0'); };
+            auto small = [](const number& n, char) { return n.value < 100; };
+            auto save = [](number& n, auto) { saved = n.value; };
+
+            return table(
+                src<idle> + ev<char> == eq<'('> = dst<number>,
+                src<idle> + ev<char> == eq<'['> = enter<Sub>,
+                src<number> + ev<char> == (pred(small) && in_range<'0', '9'>) != push,
+                src<number> + ev<char> == eq<')'> = dst<idle>,
+                src<number> + onExit != save,
+                exit<Sub> + onEnter = dst<idle>  //
+            );
+        }
+    };
+
+    // Data of number shares storage with the data of Sub and its state
+    static_assert(sizeof(SM<M>) == 2 * sizeof(int));
+    static_assert(!std::is_copy_constructible_v<SM<M>>);
+
+    {
+        SM<M> sm;
+        TEST_ASSERT_EQUAL(4, sm.feed(std::string_view{"(1234"}));
+        TEST_ASSERT_EQUAL(123, (sm.local<M, M::number>()->value));
+        TEST_ASSERT_TRUE(sm.local<Sub>() == nullptr);
+
+        // Data is made anew on each entry
+        TEST_ASSERT_EQUAL(5, sm.feed(std::string_view{")(45)"}));
+        TEST_ASSERT_EQUAL(45, saved);
+        TEST_ASSERT_TRUE((sm.local<M, M::number>() == nullptr));
+
+        TEST_ASSERT_TRUE(sm.feed('['));
+        TEST_ASSERT_EQUAL(2, Tracked::alive);
+        TEST_ASSERT_TRUE(sm.local<Sub>() != nullptr);
+        TEST_ASSERT_TRUE((sm.local<Sub, Sub::a>() != nullptr));
+
+        TEST_ASSERT_TRUE(sm.feed('.'));
+        TEST_ASSERT_TRUE((sm.is<M, M::idle>()));
+        TEST_ASSERT_EQUAL(0, Tracked::alive);
+
+        TEST_ASSERT_TRUE(sm.feed('['));
+        sm.reset();
+        TEST_ASSERT_EQUAL(0, Tracked::alive);
+
+        TEST_ASSERT_TRUE(sm.feed('['));
+    }
+    TEST_ASSERT_EQUAL(0, Tracked::alive);
+}
+
 }  // namespace sml
 
 TESTS_MAIN
@@ -0,0 +1,139 @@
+#include <sml/make.h>
+#include <sml/sm.h>
+#include <sml/syntax.h>
+
+#include <utest/utest.h>
+
+#include <string_view>
+
+namespace sml {
+
+template <typename A, typename B>
+concept Conjunctive = requires(A a, B b) { a && b; };
+
+template <typename A, typename B>
+concept Same = std::same_as<std::remove_cvref_t<A>, std::remove_cvref_t<B>>;
+
+struct AnyGuard {
+    bool operator()(auto, auto) const {
+        return true;
+    }
+};
+
+TEST(test_value_guards_fold) {
+    using impl::guard::ByteSet;
+    using impl::guard::In;
+
+    static_assert(Same<decltype(eq<'a'> || eq<'b'>), decltype(eq<'a', 'b'>)>);
+    static_assert(Same<decltype(eq<'a'> && eq<'b'>), In<ByteSet{}>>);
+    static_assert(Same<decltype(!!one_of<"+-">), decltype(one_of<"-+">)>);
+    static_assert(Same<
+                  decltype(in_range<'a', 'z'> && !eq<'x'>),
+                  decltype(in_range<'a', 'w'> || in_range<'y', 'z'>)>);
+
+    auto digit_or_sign = in_range<'0', '9'> || one_of<"+-">;
+    TEST_ASSERT_TRUE(digit_or_sign(0, '7'));
+    TEST_ASSERT_TRUE(digit_or_sign(0, '-'));
+    TEST_ASSERT_FALSE(digit_or_sign(0, 'a'));
+}
+
+TEST(test_guards_compose_with_predicates) {
+    using namespace impl::guard;
+
+    int calls = 0;
+    auto even = pred([&](auto, char c) {
+        ++calls;
+        return c % 2 == 0;
+    });
+    auto g = in_range<'0', '9'> && even;
+
+    TEST_ASSERT_TRUE(g(0, '4'));
+    TEST_ASSERT_FALSE(g(0, '5'));
+    TEST_ASSERT_FALSE(g(0, 'b'));
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_TRUE((!(even || eq<'a'>))(0, 'c'));
+
+    static_assert(ValuesI<decltype(g)>::Values == ByteSet::range('0', '9'));
+    static_assert(!ValuesI<decltype(g)>::Pure);
+    static_assert(ValuesI<decltype(even && eq<'a'>)>::Values == ByteSet::all());
+    static_assert(ValuesI<decltype(eq<'a'> || !eq<'a'>)>::Values == ByteSet::all());
+}
+
+TEST(test_operators_are_constrained) {
+    using G = decltype(eq<'a'>);
+    using P = decltype(pred(AnyGuard{}));
+    using A = decltype(act([](auto, auto) {}));
+
+    static_assert(Conjunctive<G, P>);
+    static_assert(!Conjunctive<G, AnyGuard>);
+    static_assert(!Conjunctive<AnyGuard, AnyGuard>);
+    static_assert(!Conjunctive<G, A>);
+    static_assert(Same<decltype(A{}, A{}), impl::action::Seq<A, A>>);
+}
+
+TEST(test_legacy_operators_lift_callables) {
+    using namespace legacy;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    int a = 0;
+    auto g = AnyGuard{} && !eq<'a'>;
+    auto ab = ([&](auto, int) { ++a; }, act([&](auto, int e) { a += e; }));
+#pragma GCC diagnostic pop
+
+    static_assert(impl::guard::Expr<decltype(g)>);
+    static_assert(!impl::guard::ValuesI<decltype(g)>::Pure);
+    TEST_ASSERT_TRUE(g(0, 'b'));
+    TEST_ASSERT_FALSE(g(0, 'a'));
+
+    ab(0, 10);
+    TEST_ASSERT_EQUAL(11, a);
+}
+
+TEST(test_actions_sequence) {
+    int a = 0;
+    int b = 0;
+    auto ab = (act([&](auto, int) { a = b + 1; }), act([&](auto, int e) { b = a + e; }));
+
+    ab(0, 10);
+    TEST_ASSERT_EQUAL(1, a);
+    TEST_ASSERT_EQUAL(11, b);
+}
+
+TEST(test_sm_with_guard_expressions) {
+    static int digits, words;
+
+    struct M {
+        using InitialId = int;  // NOLINT
+
+        auto transitions() {
+            auto count = [](int& c) { return act([&c](auto, char) { ++c; }); };
+
+            return table(
+                src<int> + ev<char> == in_range<'0', '9'> != count(digits),
+                src<int> + ev<char> == (in_range<'a', 'z'> || eq<'_'>) != count(words),
+                src<int> + ev<char> == eq<';'> = x,
+                src<int> + ev<char> == !eq<'?'>  // anything but '?' is skipped
+            );
+        }
+    };
+
+    digits = words = 0;
+    SM<M> sm;
+
+    SECTION("accepted events") {
+        std::string_view s = "a1_ 2;";
+        TEST_ASSERT_EQUAL(s.size(), sm.feed(s));
+        TEST_ASSERT_EQUAL(2, digits);
+        TEST_ASSERT_EQUAL(2, words);
+        TEST_ASSERT_TRUE((sm.is<M, TerminalStateId>()));
+    }
+
+    SECTION("rejected events") {
+        TEST_ASSERT_FALSE(sm.feed('?'));
+        TEST_ASSERT_TRUE((sm.is<M, int>()));
+    }
+}
+
+}  // namespace sml
+
+TESTS_MAIN